@@ -8,21 +8,97 @@
 #ifndef _ORANGES_CONSOLE_H_
 #define _ORANGES_CONSOLE_H_
 
-/* CONSOLE */
+/* 启动时的 80x25 模式，宽度也是所有模式中最窄的 */
+#define SCREEN_SIZE (80 * 25)
+#define SCREEN_WIDTH 80
+
+/* 文本模式，见 vga.c */
+#define CON_MODE_80x25 0
+#define CON_MODE_80x50 1
+#define CON_MODE_90x60 2
+#define NR_CON_MODES 3
+#define CON_MAX_SCREEN (90 * 60) /* 最大的屏幕 */
+
+#define CON_ROWS 200							/* 80 列时每个控制台在 RAM 中保存的行数 */
+#define CON_MEM_CELLS (CON_ROWS * SCREEN_WIDTH) /* 每个控制台的格子数，不能超过显存 */
+#define CON_DIRTY_WORDS ((CON_ROWS + 31) / 32)
+#define CON_SNAP_CELLS CON_MAX_SCREEN /* 每个控制台屏幕快照的格子数 */
+
+/* out_string 解析 ESC 序列的状态 */
+#define ESC_NONE 0		/* 普通字符 */
+#define ESC_GOT_ESC 1	/* 收到了 ESC */
+#define ESC_CSI 2		/* 收到了 ESC [ ，正在读参数 */
+#define ESC_MAX_PARAMS 8 /* CSI 最多保存的参数个数 */
+
+#define CON_HIST_LINES 1024	 /* 每个控制台最多保存的历史行数 */
+#define CON_HIST_BYTES 0x8000 /* 每个控制台历史记录的字节数，必须是 2 的幂 */
+
+/* HISTORY
+ * 从控制台上卷走的行，保存在 CON_HIST_BASE 开始的 RAM 中，写满后覆盖最旧的。
+ * 每行的格式：字符个数 n(去掉行尾的空白)，n 个字符，属性段数 m，
+ * m 个 (长度, 属性)。行号一直递增，line[] 用行号对 CON_HIST_LINES 取模。
+ */
+typedef struct s_history
+{
+	u8 *buf;				  /* 环形缓冲区 */
+	u32 head;				  /* 一共写了多少字节 */
+	u32 first;				  /* 最早的还保存着的行号 */
+	u32 next;				  /* 下一行的行号 */
+	u32 line[CON_HIST_LINES]; /* 每行开始时的 head */
+	int view;				  /* 屏幕顶上是倒数第几个历史行，0 表示没在看历史 */
+} HISTORY;
+
+/* CONSOLE
+ * 控制台的内容在 CON_MEM_BASE 开始的 RAM 中(影子缓冲区)，各个地址都是
+ * 在影子缓冲区中的格子下标。当前控制台减去 original_addr 之后一对一地
+ * 对应到显存，dirty 中为 1 的行表示显存中的这一行还没有更新。
+ * 输出写满 nr_rows 行之后，把最后一屏搬回开头接着写(见 wrap_console)，
+ * 平时滚屏只改 CRTC 的显示起始地址。
+ */
 typedef struct s_console
 {
 	unsigned int current_start_addr; /* 当前显示到了什么位置	  */
-	unsigned int original_addr;		 /* 当前控制台对应显存位置 */
-	unsigned int v_mem_limit;		 /* 当前控制台占的显存大小 */
+	unsigned int original_addr;		 /* 当前控制台在影子缓冲区中的位置 */
+	unsigned int v_mem_limit;		 /* 当前控制台占的格子数 */
+	int mode;						 /* CON_MODE_80x25 等 */
+	int width;						 /* 屏幕的列数 */
+	int height;						 /* 屏幕的行数 */
+	unsigned int screen_size;		 /* width * height */
+	int nr_rows;					 /* 控制台的行数，v_mem_limit / width */
 	unsigned int cursor;			 /* 当前光标位置 */
+	unsigned int render_pos;		 /* render_char 画到了哪里 */
+	volatile u32 dirty[CON_DIRTY_WORDS]; /* 每行一位，显存需要更新的行 */
+	HISTORY hist;						 /* 上卷走的行 */
+	u16 *snap;							 /* save_screen 保存的屏幕 */
+	unsigned int snap_start;			 /* 保存时的显示起始地址 */
+	unsigned int snap_cursor;			 /* 保存时的光标位置 */
+	u8 attr;							 /* SGR 设置的字符属性 */
+	int esc_state;						 /* ESC_NONE 等 */
+	int esc_params[ESC_MAX_PARAMS];		 /* CSI 的参数 */
+	int esc_nr_params;					 /* 已经开始读的参数个数 */
+	int scroll_top;						 /* 滚动区域 [top, bottom)，屏幕上的行 */
+	int scroll_bottom;					 /* 为 0 时没有设置滚动区域 */
+	int edit_base;						 /* TTY 编辑区的开头(行首)，内容搬动时跟着搬 */
 } CONSOLE;
 
+/* CRTC 的光标和显示起始地址。
+ * flush 只记下想要的值，由 console_tick 每个 tick 最多写一次，
+ * 值没有变的寄存器不写。
+ */
+typedef struct s_crtc
+{
+	volatile unsigned int want_cursor; /* 想要的光标位置 */
+	volatile unsigned int want_start;  /* 想要的显示起始地址 */
+	volatile int dirty;				   /* 有还没写进 CRTC 的值 */
+	unsigned int cursor;			   /* CRTC 中现在的光标位置 */
+	unsigned int start;				   /* CRTC 中现在的显示起始地址 */
+	u32 requests;					   /* flush 请求的次数 */
+	u32 port_writes;				   /* 实际写端口的次数 */
+} CRTC;
+
 #define SCR_UP 1  /* scroll forward */
 #define SCR_DN -1 /* scroll backward */
 
-#define SCREEN_SIZE (80 * 25)
-#define SCREEN_WIDTH 80
-
 #define DEFAULT_CHAR_COLOR 0x07		/* 0000 0111 黑底白字 */
 #define RED_CHAR_COLOR 0x04			/* 0000 0100 黑底红字 */
 #define WHITE_BACKGROUND_COLOR 0x70 /* 0111 0000 白底黑字 */
@@ -45,7 +45,8 @@
 #define	RPL_USER	SA_RPL3
 
 /* TTY */
-#define NR_CONSOLES	3	/* consoles */
+#define NR_CONSOLES	12	/* consoles, Alt + F1~F12 */
+#define NR_BOOT_CONSOLES	3	/* 启动时打开的控制台，其余第一次切换过去时打开 */
 
 /* 8259A interrupt controller ports. */
 #define	INT_M_CTL	0x20	/* I/O port for interrupt controller         <Master> */
@@ -70,8 +71,11 @@
 #define KB_CMD		0x64	/* I/O port for keyboard command
 					Read : Read Status Register
 					Write: Write Input Buffer(8042 Command) */
+#define KB_STAT_IBF	0x02	/* status: input buffer full, don't write yet */
 #define LED_CODE	0xED
+#define KB_TYPEMATIC	0xF3	/* set typematic rate/delay */
 #define KB_ACK		0xFA
+#define KB_RESEND	0xFE
 
 /* VGA */
 #define	CRTC_ADDR_REG	0x3D4	/* CRT Controller Registers - Addr Register */
@@ -82,6 +86,19 @@
 #define	CURSOR_L	0xF	/* reg index of cursor position (LSB) */
 #define	V_MEM_BASE	0xB8000	/* base of color video memory */
 #define	V_MEM_SIZE	0x8000	/* 32K: B8000H -> BFFFFH */
+#define	VGA_AC_INDEX	0x3C0	/* Attribute Controller - Index/Data Write */
+#define	VGA_MISC_WRITE	0x3C2	/* Miscellaneous Output Register - Write */
+#define	VGA_SEQ_INDEX	0x3C4	/* Sequencer - Index */
+#define	VGA_SEQ_DATA	0x3C5	/* Sequencer - Data */
+#define	VGA_GC_INDEX	0x3CE	/* Graphics Controller - Index */
+#define	VGA_GC_DATA	0x3CF	/* Graphics Controller - Data */
+#define	VGA_INSTAT_READ	0x3DA	/* Input Status #1, resets the AC flip-flop */
+#define	VGA_FONT_BASE	0xA0000	/* plane 2 (font) when mapped by vga.c */
+#define	CON_MEM_BASE	0x300000	/* 控制台的 RAM 影子缓冲区，3M 以上内核没有用到 */
+#define	CON_HIST_BASE	0x400000	/* 控制台的历史记录 */
+#define	CON_SNAP_BASE	0x480000	/* 控制台的屏幕快照 */
+#define	EDIT_BASE	0x500000	/* 每个 TTY 的编辑缓存(EDIT) */
+#define	EDIT_REGION_BYTES	0x100000	/* EDIT 区域到 0x600000 为止 */
 
 /* Hardware interrupts */
 #define	NR_IRQ		16	/* Number of IRQs */
@@ -33,5 +33,6 @@ extern  TASK            user_proc_table[];
 extern	irq_handler	irq_table[];
 extern	TTY		tty_table[];
 extern  CONSOLE         console_table[];
+extern  SERIAL          serial_table[];
 
 
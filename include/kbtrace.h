@@ -0,0 +1,105 @@
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                              kbtrace.h
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                                                    Forrest Yu, 2005
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+/********************************************************************/
+/*    Scan code trace replayed by Ctrl+F11 / Ctrl+F12.              */
+/*    It should be and can only be included by keyboard.c!          */
+/********************************************************************/
+
+#ifndef	_ORANGES_KBTRACE_H_
+#define	_ORANGES_KBTRACE_H_
+
+
+/* 以 HZ=100 录下的一段输入：每个键按住 40ms，键与键之间隔 20ms，
+ * 大写字母和符号带着左 Shift 的按下与释放。
+ * 格式与 Ctrl+F10 导出的相同：{ticks, 扫描码}，ticks 只看相对值。
+ * 文本内容：
+ *	The quick brown fox jumps over the lazy dog.
+ *	Orange'S replays this trace to time the whole input path!
+ *	int main() { return strcmp("abc", "abd") < 0 ? 1 : 0; }
+ *	pack my box with five dozen liquor jugs, 0123456789
+ */
+KB_TRACE_ENTRY kb_replay_trace[] = {
+	{0, 0x2A}, {2, 0x14}, {6, 0x94}, {8, 0xAA}, {12, 0x23}, {16, 0xA3},
+	{20, 0x12}, {24, 0x92}, {28, 0x39}, {32, 0xB9}, {36, 0x10}, {40, 0x90},
+	{44, 0x16}, {48, 0x96}, {52, 0x17}, {56, 0x97}, {60, 0x2E}, {64, 0xAE},
+	{68, 0x25}, {72, 0xA5}, {76, 0x39}, {80, 0xB9}, {84, 0x30}, {88, 0xB0},
+	{92, 0x13}, {96, 0x93}, {100, 0x18}, {104, 0x98}, {108, 0x11}, {112, 0x91},
+	{116, 0x31}, {120, 0xB1}, {124, 0x39}, {128, 0xB9}, {132, 0x21}, {136, 0xA1},
+	{140, 0x18}, {144, 0x98}, {148, 0x2D}, {152, 0xAD}, {156, 0x39}, {160, 0xB9},
+	{164, 0x24}, {168, 0xA4}, {172, 0x16}, {176, 0x96}, {180, 0x32}, {184, 0xB2},
+	{188, 0x19}, {192, 0x99}, {196, 0x1F}, {200, 0x9F}, {204, 0x39}, {208, 0xB9},
+	{212, 0x18}, {216, 0x98}, {220, 0x2F}, {224, 0xAF}, {228, 0x12}, {232, 0x92},
+	{236, 0x13}, {240, 0x93}, {244, 0x39}, {248, 0xB9}, {252, 0x14}, {256, 0x94},
+	{260, 0x23}, {264, 0xA3}, {268, 0x12}, {272, 0x92}, {276, 0x39}, {280, 0xB9},
+	{284, 0x26}, {288, 0xA6}, {292, 0x1E}, {296, 0x9E}, {300, 0x2C}, {304, 0xAC},
+	{308, 0x15}, {312, 0x95}, {316, 0x39}, {320, 0xB9}, {324, 0x20}, {328, 0xA0},
+	{332, 0x18}, {336, 0x98}, {340, 0x22}, {344, 0xA2}, {348, 0x34}, {352, 0xB4},
+	{356, 0x1C}, {360, 0x9C}, {364, 0x2A}, {366, 0x18}, {370, 0x98}, {372, 0xAA},
+	{376, 0x13}, {380, 0x93}, {384, 0x1E}, {388, 0x9E}, {392, 0x31}, {396, 0xB1},
+	{400, 0x22}, {404, 0xA2}, {408, 0x12}, {412, 0x92}, {416, 0x28}, {420, 0xA8},
+	{424, 0x2A}, {426, 0x1F}, {430, 0x9F}, {432, 0xAA}, {436, 0x39}, {440, 0xB9},
+	{444, 0x13}, {448, 0x93}, {452, 0x12}, {456, 0x92}, {460, 0x19}, {464, 0x99},
+	{468, 0x26}, {472, 0xA6}, {476, 0x1E}, {480, 0x9E}, {484, 0x15}, {488, 0x95},
+	{492, 0x1F}, {496, 0x9F}, {500, 0x39}, {504, 0xB9}, {508, 0x14}, {512, 0x94},
+	{516, 0x23}, {520, 0xA3}, {524, 0x17}, {528, 0x97}, {532, 0x1F}, {536, 0x9F},
+	{540, 0x39}, {544, 0xB9}, {548, 0x14}, {552, 0x94}, {556, 0x13}, {560, 0x93},
+	{564, 0x1E}, {568, 0x9E}, {572, 0x2E}, {576, 0xAE}, {580, 0x12}, {584, 0x92},
+	{588, 0x39}, {592, 0xB9}, {596, 0x14}, {600, 0x94}, {604, 0x18}, {608, 0x98},
+	{612, 0x39}, {616, 0xB9}, {620, 0x14}, {624, 0x94}, {628, 0x17}, {632, 0x97},
+	{636, 0x32}, {640, 0xB2}, {644, 0x12}, {648, 0x92}, {652, 0x39}, {656, 0xB9},
+	{660, 0x14}, {664, 0x94}, {668, 0x23}, {672, 0xA3}, {676, 0x12}, {680, 0x92},
+	{684, 0x39}, {688, 0xB9}, {692, 0x11}, {696, 0x91}, {700, 0x23}, {704, 0xA3},
+	{708, 0x18}, {712, 0x98}, {716, 0x26}, {720, 0xA6}, {724, 0x12}, {728, 0x92},
+	{732, 0x39}, {736, 0xB9}, {740, 0x17}, {744, 0x97}, {748, 0x31}, {752, 0xB1},
+	{756, 0x19}, {760, 0x99}, {764, 0x16}, {768, 0x96}, {772, 0x14}, {776, 0x94},
+	{780, 0x39}, {784, 0xB9}, {788, 0x19}, {792, 0x99}, {796, 0x1E}, {800, 0x9E},
+	{804, 0x14}, {808, 0x94}, {812, 0x23}, {816, 0xA3}, {820, 0x2A}, {822, 0x02},
+	{826, 0x82}, {828, 0xAA}, {832, 0x1C}, {836, 0x9C}, {840, 0x17}, {844, 0x97},
+	{848, 0x31}, {852, 0xB1}, {856, 0x14}, {860, 0x94}, {864, 0x39}, {868, 0xB9},
+	{872, 0x32}, {876, 0xB2}, {880, 0x1E}, {884, 0x9E}, {888, 0x17}, {892, 0x97},
+	{896, 0x31}, {900, 0xB1}, {904, 0x2A}, {906, 0x0A}, {910, 0x8A}, {912, 0xAA},
+	{916, 0x2A}, {918, 0x0B}, {922, 0x8B}, {924, 0xAA}, {928, 0x39}, {932, 0xB9},
+	{936, 0x2A}, {938, 0x1A}, {942, 0x9A}, {944, 0xAA}, {948, 0x39}, {952, 0xB9},
+	{956, 0x13}, {960, 0x93}, {964, 0x12}, {968, 0x92}, {972, 0x14}, {976, 0x94},
+	{980, 0x16}, {984, 0x96}, {988, 0x13}, {992, 0x93}, {996, 0x31}, {1000, 0xB1},
+	{1004, 0x39}, {1008, 0xB9}, {1012, 0x1F}, {1016, 0x9F}, {1020, 0x14}, {1024, 0x94},
+	{1028, 0x13}, {1032, 0x93}, {1036, 0x2E}, {1040, 0xAE}, {1044, 0x32}, {1048, 0xB2},
+	{1052, 0x19}, {1056, 0x99}, {1060, 0x2A}, {1062, 0x0A}, {1066, 0x8A}, {1068, 0xAA},
+	{1072, 0x2A}, {1074, 0x28}, {1078, 0xA8}, {1080, 0xAA}, {1084, 0x1E}, {1088, 0x9E},
+	{1092, 0x30}, {1096, 0xB0}, {1100, 0x2E}, {1104, 0xAE}, {1108, 0x2A}, {1110, 0x28},
+	{1114, 0xA8}, {1116, 0xAA}, {1120, 0x33}, {1124, 0xB3}, {1128, 0x39}, {1132, 0xB9},
+	{1136, 0x2A}, {1138, 0x28}, {1142, 0xA8}, {1144, 0xAA}, {1148, 0x1E}, {1152, 0x9E},
+	{1156, 0x30}, {1160, 0xB0}, {1164, 0x20}, {1168, 0xA0}, {1172, 0x2A}, {1174, 0x28},
+	{1178, 0xA8}, {1180, 0xAA}, {1184, 0x2A}, {1186, 0x0B}, {1190, 0x8B}, {1192, 0xAA},
+	{1196, 0x39}, {1200, 0xB9}, {1204, 0x2A}, {1206, 0x33}, {1210, 0xB3}, {1212, 0xAA},
+	{1216, 0x39}, {1220, 0xB9}, {1224, 0x0B}, {1228, 0x8B}, {1232, 0x39}, {1236, 0xB9},
+	{1240, 0x2A}, {1242, 0x35}, {1246, 0xB5}, {1248, 0xAA}, {1252, 0x39}, {1256, 0xB9},
+	{1260, 0x02}, {1264, 0x82}, {1268, 0x39}, {1272, 0xB9}, {1276, 0x2A}, {1278, 0x27},
+	{1282, 0xA7}, {1284, 0xAA}, {1288, 0x39}, {1292, 0xB9}, {1296, 0x0B}, {1300, 0x8B},
+	{1304, 0x27}, {1308, 0xA7}, {1312, 0x39}, {1316, 0xB9}, {1320, 0x2A}, {1322, 0x1B},
+	{1326, 0x9B}, {1328, 0xAA}, {1332, 0x1C}, {1336, 0x9C}, {1340, 0x19}, {1344, 0x99},
+	{1348, 0x1E}, {1352, 0x9E}, {1356, 0x2E}, {1360, 0xAE}, {1364, 0x25}, {1368, 0xA5},
+	{1372, 0x39}, {1376, 0xB9}, {1380, 0x32}, {1384, 0xB2}, {1388, 0x15}, {1392, 0x95},
+	{1396, 0x39}, {1400, 0xB9}, {1404, 0x30}, {1408, 0xB0}, {1412, 0x18}, {1416, 0x98},
+	{1420, 0x2D}, {1424, 0xAD}, {1428, 0x39}, {1432, 0xB9}, {1436, 0x11}, {1440, 0x91},
+	{1444, 0x17}, {1448, 0x97}, {1452, 0x14}, {1456, 0x94}, {1460, 0x23}, {1464, 0xA3},
+	{1468, 0x39}, {1472, 0xB9}, {1476, 0x21}, {1480, 0xA1}, {1484, 0x17}, {1488, 0x97},
+	{1492, 0x2F}, {1496, 0xAF}, {1500, 0x12}, {1504, 0x92}, {1508, 0x39}, {1512, 0xB9},
+	{1516, 0x20}, {1520, 0xA0}, {1524, 0x18}, {1528, 0x98}, {1532, 0x2C}, {1536, 0xAC},
+	{1540, 0x12}, {1544, 0x92}, {1548, 0x31}, {1552, 0xB1}, {1556, 0x39}, {1560, 0xB9},
+	{1564, 0x26}, {1568, 0xA6}, {1572, 0x17}, {1576, 0x97}, {1580, 0x10}, {1584, 0x90},
+	{1588, 0x16}, {1592, 0x96}, {1596, 0x18}, {1600, 0x98}, {1604, 0x13}, {1608, 0x93},
+	{1612, 0x39}, {1616, 0xB9}, {1620, 0x24}, {1624, 0xA4}, {1628, 0x16}, {1632, 0x96},
+	{1636, 0x22}, {1640, 0xA2}, {1644, 0x1F}, {1648, 0x9F}, {1652, 0x33}, {1656, 0xB3},
+	{1660, 0x39}, {1664, 0xB9}, {1668, 0x0B}, {1672, 0x8B}, {1676, 0x02}, {1680, 0x82},
+	{1684, 0x03}, {1688, 0x83}, {1692, 0x04}, {1696, 0x84}, {1700, 0x05}, {1704, 0x85},
+	{1708, 0x06}, {1712, 0x86}, {1716, 0x07}, {1720, 0x87}, {1724, 0x08}, {1728, 0x88},
+	{1732, 0x09}, {1736, 0x89}, {1740, 0x0A}, {1744, 0x8A}, {1748, 0x1C}, {1752, 0x9C},
+};
+
+
+#endif /* _ORANGES_KBTRACE_H_ */
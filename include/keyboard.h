@@ -12,9 +12,41 @@
 /************************************************************************/
 /*                          Macros Declaration                          */
 /************************************************************************/
-#define	KB_IN_BYTES	32	/* size of keyboard input buffer */
-#define MAP_COLS	3	/* Number of columns in keymap */
-#define NR_SCAN_CODES	0x80	/* Number of scan codes (rows in keymap) */
+#define	KB_IN_BYTES	32	/* size of keyboard input buffer (must be a power of 2) */
+#define	KB_IN_MASK	(KB_IN_BYTES - 1)
+#define KB_CMD_BYTES	16	/* size of 8042 command queue (must be a power of 2) */
+#define KB_CMD_MASK	(KB_CMD_BYTES - 1)
+#define KB_CMD_RETRIES	3	/* resend a command byte at most this many times */
+#define KB_CMD_TIMEOUT	(HZ / 10)	/* ticks to wait for ACK before resending */
+#define KB_REPEAT_DELAY	500	/* ms a key is held before it starts repeating */
+#define KB_REPEAT_RATE	20	/* repeats per second */
+#define KB_HW_TYPEMATIC	0x7F	/* 8042 typematic byte: 1000ms delay, 2 per second */
+#define KB_BATCH_SIZE	KB_IN_BYTES	/* max keys handed to in_process_batch at once */
+#define KB_TRACE_BYTES	1024	/* size of scan code capture ring (must be a power of 2) */
+#define KB_TRACE_MASK	(KB_TRACE_BYTES - 1)
+#define KB_REPLAY_TIMED	0	/* replay a trace with its original timing */
+#define KB_REPLAY_FAST	1	/* replay a trace as fast as the tty can take it */
+#define MAP_COLS	7	/* Number of columns (layers) in keymap */
+#define NR_SCAN_CODES	0x80	/* Number of scan codes */
+#define NR_KEYMAP_ROWS	0x60	/* Number of rows in keymap, codes above are unused */
+
+/* Columns (layers) of keymap */
+#define KL_BASE		0	/* no Shift, no CapsLock, no NumLock */
+#define KL_NUM		1	/* NumLock */
+#define KL_CAPS		2	/* CapsLock */
+#define KL_CAPS_NUM	3	/* CapsLock + NumLock */
+#define KL_SHIFT	4	/* Shift (NumLock makes no difference) */
+#define KL_CAPS_SHIFT	5	/* Shift + CapsLock */
+#define KL_E0		6	/* E0 XX */
+
+/* States of the scan code decoder */
+#define KB_S_NORMAL	0	/* 等待新的扫描码		*/
+#define KB_S_E0		1	/* 已收到 E0			*/
+#define KB_S_E0_2A	2	/* 已收到 E0 2A			*/
+#define KB_S_E0_2A_E0	3	/* 已收到 E0 2A E0		*/
+#define KB_S_E0_B7	4	/* 已收到 E0 B7			*/
+#define KB_S_E0_B7_E0	5	/* 已收到 E0 B7 E0		*/
+#define KB_S_E1		6	/* Pause 序列 (E1 ...) 进行中	*/
 
 #define FLAG_BREAK	0x0080		/* Break Code			*/
 #define FLAG_EXT	0x0100		/* Normal function keys		*/
@@ -119,14 +151,79 @@
 /************************************************************************/
 /*                         Stucture Definition                          */
 /************************************************************************/
-/* Keyboard structure, 1 per console. */
+/* Keyboard structure, 1 per console.
+ * 单生产者/单消费者环形缓冲区：head 只由 keyboard_handler 写，
+ * tail 只由键盘任务写，二者都只增不减，取下标时与 KB_IN_MASK 相与。
+ * head - tail 即缓冲区中的字节数，因此读写两端都不需要关中断。
+ */
 typedef struct s_kb {
-	char*	p_head;			/* 指向缓冲区中下一个空闲位置 */
-	char*	p_tail;			/* 指向键盘任务应处理的字节 */
-	int	count;			/* 缓冲区中共有多少字节 */
-	char	buf[KB_IN_BYTES];	/* 缓冲区 */
+	volatile u32	head;			/* 下一个空闲位置 */
+	volatile u32	tail;			/* 键盘任务应处理的字节 */
+	u32		overflow;		/* 缓冲区满时丢弃的字节数 */
+	u32		high_water;		/* 缓冲区中曾同时存在的最多字节数 */
+	volatile u8	buf[KB_IN_BYTES];	/* 缓冲区 */
 }KB_INPUT;
 
+/* 发给 8042 的命令队列。
+ * head 只由键盘任务写；tail 指向正在等待应答的字节，由 keyboard_handler
+ * 在收到 ACK 时推进(键盘任务只在关中断时碰它)。
+ */
+typedef struct s_kb_cmd {
+	volatile u32	head;			/* 下一个空闲位置 */
+	volatile u32	tail;			/* 当前要发送/等待应答的字节 */
+	volatile int	busy;			/* 当前字节已发出，正在等待应答 */
+	int		retries;		/* 当前字节已经重发的次数 */
+	int		sent_at;		/* 当前字节发出时的 ticks */
+	u32		dropped;		/* 重发太多次而放弃的字节数 */
+	u8		buf[KB_CMD_BYTES];	/* 缓冲区 */
+}KB_CMD_QUEUE;
+
+/* 软件自动重复。
+ * 按住的键由键盘任务记录(只在 armed 为 0 时修改)，kb_repeat_tick 每个 tick
+ * 检查一次，到时间就增加 issued；键盘任务把 issued - consumed 次重复合成
+ * 一个事件。
+ */
+typedef struct s_kb_repeat {
+	volatile int	armed;			/* 是否有键正被按住 */
+	u32		key;			/* 被按住的键，含 FLAG_* */
+	u16		code;			/* 被按住的键的扫描码 */
+	volatile int	next;			/* 下一次重复时的 ticks */
+	int		delay;			/* 按下之后多少个 tick 开始重复 */
+	int		period;			/* 每隔多少个 tick 重复一次，0 表示不重复 */
+	volatile u32	issued;			/* kb_repeat_tick 产生的重复次数 */
+	u32		consumed;		/* 键盘任务已经取走的重复次数 */
+}KB_REPEAT;
+
+
+/* 录下的一个字节：收到它时的 ticks 和字节本身 */
+typedef struct s_kb_trace_entry {
+	int		tick;
+	u8		code;
+}KB_TRACE_ENTRY;
+
+/* 扫描码录制。只有 keyboard_handler 写 head 和 buf，
+ * 满了之后覆盖最旧的记录。
+ */
+typedef struct s_kb_trace {
+	volatile int	capturing;		/* 是否正在录制 */
+	volatile u32	head;			/* 已录下的字节总数 */
+	KB_TRACE_ENTRY	buf[KB_TRACE_BYTES];	/* 缓冲区 */
+}KB_TRACE;
+
+/* 扫描码回放。回放期间关掉键盘中断，由回放代替 keyboard_handler
+ * 往 kb_in 里放字节(定时回放在 kb_replay_tick 里放，全速回放由键盘任务
+ * 自己放)，所以 kb_in 仍然只有一个生产者。
+ */
+typedef struct s_kb_replay {
+	volatile int	active;			/* 是否正在回放 */
+	volatile int	done;			/* 回放结束，还没有报告结果 */
+	int		mode;			/* KB_REPLAY_TIMED / KB_REPLAY_FAST */
+	KB_TRACE_ENTRY*	trace;			/* 要回放的记录 */
+	int		len;			/* 记录的个数 */
+	volatile int	pos;			/* 下一个要放进 kb_in 的记录 */
+	int		start;			/* 开始回放时的 ticks */
+	u32		keys;			/* 回放产生的键数 */
+}KB_REPLAY;
 
 
 #endif /* _ORANGES_KEYBOARD_H_ */
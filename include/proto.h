@@ -10,6 +10,12 @@ PUBLIC void out_byte(u16 port, u8 value);
 PUBLIC u8 in_byte(u16 port);
 PUBLIC void disp_str(char *info);
 PUBLIC void disp_color_str(char *info, int color);
+PUBLIC void enable_irq(int irq);
+PUBLIC void disable_irq(int irq);
+PUBLIC void disable_int();
+PUBLIC void enable_int();
+PUBLIC u32 disable_int_save();
+PUBLIC void restore_int(u32 flags);
 
 /* protect.c */
 PUBLIC void init_prot();
@@ -36,20 +42,66 @@ PUBLIC void init_clock();
 
 /* keyboard.c */
 PUBLIC void init_keyboard();
+PUBLIC void get_kb_stat(u32 *p_overflow, u32 *p_high_water);
+PUBLIC void kb_repeat_tick();
+PUBLIC void set_typematic(int delay, int rate);
+PUBLIC void kb_toggle_capture();
+PUBLIC void kb_trace_dump(TTY *p_tty);
+PUBLIC void kb_start_replay(int mode);
+PUBLIC void kb_replay_tick();
+PUBLIC int kb_replay_poll(u32 *p_keys, int *p_ticks);
 
 /* tty.c */
 PUBLIC void task_tty();
 PUBLIC void in_process(TTY *p_tty, u32 key);
+PUBLIC int in_process_batch(TTY *p_tty, KEY_EVENT *events, int nr_events);
+PUBLIC void tty_write(TTY *p_tty, char *buf, int len);
+
+/* search.c */
+PUBLIC int search_mark(const char *text, int len, const char *pat, int pat_len,
+		       u8 *marks, int engine);
+
+/* serial.c */
+PUBLIC void init_serial();
+PUBLIC void attach_serial(TTY *p_tty, int nr_serial);
+PUBLIC void serial_handler(int irq);
+PUBLIC void serial_read(TTY *p_tty);
+PUBLIC void serial_write(SERIAL *p_serial, char *buf, int len);
 
 /* console.c */
 PUBLIC void out_char(CONSOLE *p_con, char ch, int color);
+PUBLIC void out_string(CONSOLE *p_con, const char *str, int len, int color);
 PUBLIC void scroll_screen(CONSOLE *p_con, int direction);
+PUBLIC void scroll_history(CONSOLE *p_con, int lines);
+PUBLIC void scroll_live(CONSOLE *p_con);
+PUBLIC void save_screen(CONSOLE *p_con);
+PUBLIC void restore_screen(CONSOLE *p_con);
+PUBLIC void set_char_color(CONSOLE *p_con, unsigned int pos, int color);
+PUBLIC void fill_region(CONSOLE *p_con, unsigned int pos, unsigned int len,
+			char ch, int color);
+PUBLIC void copy_region(CONSOLE *p_con, unsigned int dst, unsigned int src,
+			unsigned int len);
+PUBLIC void scroll_region(CONSOLE *p_con, int top, int bottom, int lines);
+PUBLIC void clear_console(CONSOLE *p_con);
+PUBLIC void push_rows(CONSOLE *p_con, int rows);
+PUBLIC void render_begin(CONSOLE *p_con, unsigned int pos);
+PUBLIC void render_char(CONSOLE *p_con, char ch, int color);
+PUBLIC unsigned int render_end(CONSOLE *p_con, unsigned int clear_to);
+PUBLIC void set_cursor_pos(CONSOLE *p_con, unsigned int pos);
+PUBLIC void console_tick();
+PUBLIC void console_sync();
+PUBLIC void get_crtc_stat(u32 *p_writes, u32 *p_saved);
+PUBLIC void set_console_mode(CONSOLE *p_con, int mode);
+
+/* vga.c */
+PUBLIC void vga_set_mode(int mode);
 
 /* printf.c */
 PUBLIC int printf(const char *fmt, ...);
 
 /* vsprintf.c */
 PUBLIC int vsprintf(char *buf, const char *fmt, va_list args);
+PUBLIC int sprintf(char *buf, const char *fmt, ...);
 
 /* 以下是系统调用相关 */
 
@@ -0,0 +1,32 @@
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+				search.h
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+						    Forrest Yu, 2005
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+#ifndef _ORANGES_SEARCH_H_
+#define _ORANGES_SEARCH_H_
+
+
+/* 子串搜索算法，作为 search_mark 的 engine 参数 */
+#define SEARCH_AUTO		0	/* 按模式串长度自动选择 */
+#define SEARCH_SCAN		1	/* 按字扫描首字符，再逐个比较 */
+#define SEARCH_HORSPOOL		2	/* Boyer-Moore-Horspool */
+#define SEARCH_TWO_WAY		3	/* Crochemore-Perrin Two-Way */
+#define NR_SEARCH_ENGINES	4
+
+/* SEARCH_AUTO 的选择：
+ * 模式串短于 SEARCH_SCAN_MAX 时 Horspool 的跳跃距离太小，不如直接扫首字符；
+ * 长于 SEARCH_HORSPOOL_MAX 时用 Two-Way，最坏情况也是线性的。
+ */
+#define SEARCH_SCAN_MAX		4
+#define SEARCH_HORSPOOL_MAX	32
+
+/* 在 text 中找出 pat 的所有出现(包括相互重叠的)，对每次出现的 pat_len 个
+ * 字符置 marks[i] = 1，其余为 0。返回出现的次数。
+ */
+typedef int (*search_engine)(const char *text, int len,
+			     const char *pat, int pat_len, u8 *marks);
+
+
+#endif /* _ORANGES_SEARCH_H_ */
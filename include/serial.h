@@ -0,0 +1,78 @@
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+				serial.h
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+						    Forrest Yu, 2005
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+#ifndef _ORANGES_SERIAL_H_
+#define _ORANGES_SERIAL_H_
+
+
+/* 16550 UART */
+#define COM1_PORT	0x3F8	/* I/O base of COM1 */
+#define UART_CLOCK	115200	/* base clock / 16 */
+#define SERIAL_BAUD	115200
+
+/* Register offsets */
+#define UART_RBR	0	/* Receive Buffer		(read,  DLAB=0) */
+#define UART_THR	0	/* Transmit Holding		(write, DLAB=0) */
+#define UART_DLL	0	/* Divisor Latch LSB		(DLAB=1) */
+#define UART_IER	1	/* Interrupt Enable		(DLAB=0) */
+#define UART_DLM	1	/* Divisor Latch MSB		(DLAB=1) */
+#define UART_IIR	2	/* Interrupt Identification	(read)  */
+#define UART_FCR	2	/* FIFO Control			(write) */
+#define UART_LCR	3	/* Line Control */
+#define UART_MCR	4	/* Modem Control */
+#define UART_LSR	5	/* Line Status */
+#define UART_MSR	6	/* Modem Status */
+#define UART_SCR	7	/* Scratch */
+
+#define IER_RDA		0x01	/* received data available */
+#define IER_THRE	0x02	/* transmit holding register empty */
+#define IER_RLS		0x04	/* receiver line status */
+#define IIR_NO_INT	0x01	/* no interrupt pending */
+#define IIR_ID_MASK	0x0E
+#define IIR_MSR		0x00	/* modem status */
+#define IIR_THRE	0x02	/* transmitter empty */
+#define IIR_RDA		0x04	/* received data available */
+#define IIR_RLS		0x06	/* receiver line status */
+#define IIR_TIMEOUT	0x0C	/* character timeout (FIFO) */
+#define FCR_ENABLE	0xC7	/* enable & clear FIFOs, RX trigger at 14 bytes */
+#define LCR_8N1		0x03	/* 8 data bits, no parity, 1 stop bit */
+#define LCR_DLAB	0x80	/* divisor latch access */
+#define MCR_DTR_RTS_OUT2 0x0B	/* OUT2 gates the IRQ line to the 8259 */
+#define LSR_DR		0x01	/* data ready */
+
+#define UART_FIFO_SIZE	16	/* bytes the transmitter FIFO takes at once */
+
+#define NR_SERIALS	1
+#define SERIAL_TTY	0	/* tty that COM1 is attached to by task_tty */
+
+#define SERIAL_RX_BYTES	256	/* must be a power of 2 */
+#define SERIAL_TX_BYTES	1024	/* must be a power of 2 */
+
+/* Serial port.
+ * 接收缓冲区：rx_head 只由 serial_handler 写，rx_tail 只由键盘任务写。
+ * 发送缓冲区：tx_head 由写入者在关中断时修改，tx_tail 由 serial_handler
+ * 或关了中断的 serial_write 修改。
+ */
+typedef struct s_serial
+{
+	u16		port;			/* I/O base */
+	int		present;		/* 是否检测到了 UART */
+
+	volatile u32	rx_head;
+	volatile u32	rx_tail;
+	u32		rx_overflow;		/* 接收缓冲区满时丢弃的字节数 */
+	u8		rx_buf[SERIAL_RX_BYTES];
+
+	volatile u32	tx_head;
+	volatile u32	tx_tail;
+	volatile int	tx_busy;		/* 发送器正在工作，会再来 THRE 中断 */
+	u32		tx_overflow;		/* 发送缓冲区满时丢弃的字节数 */
+	u8		tx_buf[SERIAL_TX_BYTES];
+}SERIAL;
+
+
+#endif /* _ORANGES_SERIAL_H_ */
@@ -7,4 +7,6 @@
 
 PUBLIC	void*	memcpy(void* p_dst, void* p_src, int size);
 PUBLIC	void	memset(void* p_dst, char ch, int size);
+PUBLIC	void	memset16(void* p_dst, u16 val, int count);
+PUBLIC	void	memmove16(void* p_dst, void* p_src, int count);
 PUBLIC	int	strlen(char* p_str);
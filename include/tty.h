@@ -10,8 +10,112 @@
 
 
 #define TTY_IN_BYTES	256	/* tty input queue size */
+#define EDIT_BUF_BYTES	0x4000		/* 每个 TTY 的输入缓存大小，一个控制台放得下的内容 */
+#define EDIT_SEARCH_BYTES	128		/* 搜索内容最多多少个字符，回显只占一行 */
+#define EDIT_TAB_CELLS	4		/* 制表位的间隔 */
+#define EDIT_NR_LINES	200		/* 行索引最多记多少行，每行至少占控制台的一行，不少于 CON_ROWS */
+#define UNDO_NR_OPS	256		/* 撤销日志最多记多少次操作 */
+#define UNDO_TEXT_BYTES	0x4000		/* 撤销日志中字符的总量，必须是 2 的幂 */
+#define UNDO_BURST_TICKS	HZ	/* 停顿超过这么久，之后的输入另起一次操作 */
+
+/* 撤销日志中操作的种类 */
+#define UNDO_INSERT	0	/* 在 pos 处插入 */
+#define UNDO_DELETE	1	/* 用 DELETE 从 pos 开始往后删 */
+#define UNDO_BACKSPACE	2	/* 用退格从 pos + len 开始往前删，字符是倒着记的 */
 
 struct s_console;
+struct s_serial;
+
+/* 键盘交给 tty 的键，count 是连续重复的次数 */
+typedef struct s_key_event
+{
+	u32	key;			/* 键值，含 FLAG_* */
+	int	count;			/* 重复次数 */
+}KEY_EVENT;
+
+/* 批处理统计: 每次批量处理了多少个键/字符 */
+typedef struct s_batch_stat
+{
+	u32	nr_batches;		/* 一共处理了多少批 */
+	u32	nr_items;		/* 一共处理了多少个 */
+	u32	last;			/* 最近一批的大小 */
+	u32	max;			/* 最大的一批 */
+}BATCH_STAT;
+
+/* 撤销日志中的一次操作：连续输入或连续删除的一串字符 */
+typedef struct s_undo_op
+{
+	int	kind;			/* UNDO_INSERT 等 */
+	int	pos;			/* 这串字符在缓存中的起点 */
+	int	len;			/* 字符的个数 */
+	u32	text;			/* 字符在 undo_text 中的起点，一直增加，用时取模 */
+}UNDO_OP;
+
+/* 编辑状态，每个 TTY 一个。
+ * 大小固定，sizeof(EDIT) 是 87312 字节(约 85.3K)，多一个控制台就多这么多，
+ * 其中 buf、indexs、cand 和 undo_text 一共 5 * EDIT_BUF_BYTES。12 个控制台
+ * 一共 1047744 字节，放在 EDIT_BASE 开始的 EDIT_REGION_BYTES 中，见 tty.c。
+ * 输入的内容放在 gap buffer 中：buf[0..gap_start) 是光标之前的字符，
+ * buf[gap_end..EDIT_BUF_BYTES) 是光标之后的字符，中间是空出来的 gap。
+ * 在光标处插入、删除只动 gap 的两端，移动光标时一次搬一个字符。
+ * 行索引也在光标所在的行分成两半，见 line_start。
+ */
+typedef struct s_edit
+{
+	int	current_mode;			/* 0: 输入模式  1: 搜索模式 */
+	int	before_mode;			/* 切换之前的模式 */
+
+	char	buf[EDIT_BUF_BYTES];		/* 输入的字符，用于搜索 */
+	int	p_buf;				/* buf 中有效字符的个数 */
+	int	gap_start;			/* 光标，也是 gap 的开始 */
+	int	gap_end;			/* gap 的结束 */
+	int	saved_cursor;			/* 搜索时 gap 挪到最后，之前光标在哪里 */
+
+	/* 行索引：每一行(用 '\n' 分开)从哪个字符开始，从屏幕上的哪一行开始。
+	 * 第 0 ~ cur_line 行从数组的开头往后放，记的是从头算起的值；之后的行
+	 * 从数组的末尾往前放，记的是到 p_buf 和 nr_rows 的距离。这样在光标处
+	 * 编辑时只有光标所在的行要改，光标跨过 '\n' 时搬一项。
+	 */
+	u16	line_start[EDIT_NR_LINES];	/* 行首的字符 */
+	u16	line_row[EDIT_NR_LINES];	/* 行首在屏幕上的行 */
+	int	nr_lines;			/* 一共有几行 */
+	int	cur_line;			/* 光标所在的行 */
+	int	cur_col;			/* 光标在这一行中的列，TAB 展开到制表位 */
+	int	cur_cells;			/* 光标所在的行一共占多少格 */
+	int	nr_rows;			/* 所有的行在屏幕上占多少行 */
+
+	/* 屏幕上的位置都从编辑区的开头(控制台的 edit_base)算起 */
+	int	end_pos;			/* 屏幕上画出来的内容到哪里为止 */
+	int	dirty_from;			/* 从这个字符起屏幕上的不对，没有则为 -1 */
+	int	cursor_dirty;			/* 光标动了，还没有放到屏幕上 */
+
+	/* 撤销日志：[undo_first, undo_top) 可以撤销，[undo_top, undo_end) 可以重做。
+	 * 操作和字符都放在环形缓冲区中，装不下时丢掉最早的操作。
+	 */
+	UNDO_OP	undo_ops[UNDO_NR_OPS];
+	char	undo_text[UNDO_TEXT_BYTES];
+	u32	undo_first;			/* 最早的还留着的操作 */
+	u32	undo_top;			/* 下一次撤销 undo_top - 1 */
+	u32	undo_end;			/* 最后一次操作之后 */
+	u32	undo_head;			/* undo_text 中下一个空闲位置 */
+	int	undo_sealed;			/* 下一次编辑另起一次操作 */
+	int	undo_tick;			/* 最近一次记录的 ticks */
+
+	char	search_buf[EDIT_SEARCH_BYTES];	/* 搜索模式的输入 */
+	int	p_search_buf;			/* search_buf 中字符的个数 */
+	u8	indexs[EDIT_BUF_BYTES];		/* buf[i] 属于某个匹配时为 1 */
+	int	search_has_done;		/* 搜索是否已完成 */
+
+	/* 增量搜索：cand[0..level_end[k]) 是和搜索内容前 k 个字符匹配的起点 */
+	u16	cand[EDIT_BUF_BYTES];		/* 候选的起始位置 */
+	u16	level_end[EDIT_SEARCH_BYTES + 1];	/* 每一层候选的个数 */
+	int	search_level;			/* 已经参与匹配的搜索字符数 */
+	int	marks_dirty;			/* 候选变了，高亮还没有更新 */
+	int	results_dirty;			/* 搜索结果要重画 */
+	int	screen_saved;			/* 进入搜索模式时保存了屏幕 */
+
+	int	time_counter;			/* 上次清屏时的 ticks */
+}EDIT;
 
 /* TTY */
 typedef struct s_tty
@@ -21,7 +125,12 @@ typedef struct s_tty
 	u32*	p_inbuf_tail;		/* 指向键盘任务应处理的键值 */
 	int	inbuf_count;		/* 缓冲区中已经填充了多少 */
 
+	BATCH_STAT	read_stat;	/* in_process_batch 每批的键数 */
+	BATCH_STAT	write_stat;	/* tty_do_write 每批输出的字符数 */
+
 	struct s_console *	p_console;
+	struct s_serial *	p_serial;	/* 挂在这个 TTY 上的串口，没有则为 0 */
+	EDIT *			p_edit;		/* 编辑状态 */
 }TTY;
 
 
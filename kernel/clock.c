@@ -12,6 +12,7 @@
 #include "proc.h"
 #include "tty.h"
 #include "console.h"
+#include "serial.h"
 #include "global.h"
 #include "proto.h"
 
@@ -24,6 +25,10 @@ PUBLIC void clock_handler(int irq)
 	ticks++;
 	p_proc_ready->ticks--;
 
+	kb_repeat_tick();
+	kb_replay_tick();
+	console_tick();
+
 	if (k_reenter != 0) {
 		return;
 	}
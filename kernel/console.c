@@ -18,6 +18,7 @@
 #include "proc.h"
 #include "tty.h"
 #include "console.h"
+#include "serial.h"
 #include "global.h"
 #include "keyboard.h"
 #include "proto.h"
@@ -25,6 +26,50 @@
 PRIVATE void set_cursor(unsigned int position);
 PRIVATE void set_video_start_addr(u32 addr);
 PRIVATE void flush(CONSOLE* p_con);
+PRIVATE void crtc_apply();
+PRIVATE u8 char_attr(int color);
+PRIVATE void out_cursor_ctrl(CONSOLE* p_con, char ch, int color);
+PRIVATE void render_cell(CONSOLE* p_con, unsigned int pos, char ch, u8 attr);
+PRIVATE void mark_dirty(CONSOLE* p_con, unsigned int from, unsigned int to);
+PRIVATE void blit_dirty_rows(CONSOLE* p_con);
+PRIVATE void blit_screen(CONSOLE* p_con);
+PRIVATE void wrap_console(CONSOLE* p_con);
+PRIVATE void shift_console(CONSOLE* p_con, unsigned int shift);
+PRIVATE void follow_cursor(CONSOLE* p_con);
+PRIVATE void hist_push(HISTORY* h, u16* row, int width);
+PRIVATE void hist_line(HISTORY* h, u32 nr, u16* row, int width);
+PRIVATE void draw_history(CONSOLE* p_con);
+PRIVATE int view_top(CONSOLE* p_con);
+PRIVATE void line_feed(CONSOLE* p_con, int color);
+PRIVATE void wrap_row(CONSOLE* p_con);
+PRIVATE int screen_row(CONSOLE* p_con, unsigned int pos);
+PRIVATE void esc_byte(CONSOLE* p_con, char ch);
+PRIVATE void csi_dispatch(CONSOLE* p_con, char final);
+PRIVATE void csi_sgr(CONSOLE* p_con);
+PRIVATE void set_geometry(CONSOLE* p_con, int mode);
+PRIVATE void use_vga_mode(int mode);
+
+/* 影子缓冲区中第 pos 个格子 */
+#define CON_CELL(pos)	((u16*)CON_MEM_BASE + (pos))
+
+/* 空白格子 */
+#define BLANK_CELL	((DEFAULT_CHAR_COLOR << 8) | ' ')
+
+/* 各个模式的列数和行数 */
+PRIVATE const int con_geometry[NR_CON_MODES][2] = {
+	{80, 25},	/* CON_MODE_80x25 */
+	{80, 50},	/* CON_MODE_80x50 */
+	{90, 60}	/* CON_MODE_90x60 */
+};
+
+/* 显卡现在的模式 */
+PRIVATE int vga_mode = CON_MODE_80x25;
+
+/* ANSI 颜色号对应的 VGA 颜色 */
+PRIVATE const u8 ansi_color[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+/* 开始时不知道 CRTC 里是什么，第一次一定要写 */
+PRIVATE CRTC crtc = {0, 0, 0, -1, -1, 0, 0};
 
 /*======================================================================*
 			   init_screen
@@ -34,27 +79,46 @@ PUBLIC void init_screen(TTY* p_tty)
 	int nr_tty = p_tty - tty_table;
 	p_tty->p_console = console_table + nr_tty;
 
-	int v_mem_size = V_MEM_SIZE >> 1;	/* 显存总大小 (in WORD) */
+	CONSOLE* p_con = p_tty->p_console;
 
-	int con_v_mem_size                   = v_mem_size / NR_CONSOLES;
-	p_tty->p_console->original_addr      = nr_tty * con_v_mem_size;
-	p_tty->p_console->v_mem_limit        = con_v_mem_size;
-	p_tty->p_console->current_start_addr = p_tty->p_console->original_addr;
+	p_con->original_addr      = nr_tty * CON_MEM_CELLS;
+	set_geometry(p_con, CON_MODE_80x25);
+	p_con->current_start_addr = p_con->original_addr;
 
 	/* 默认光标位置在最开始处 */
-	p_tty->p_console->cursor = p_tty->p_console->original_addr;
+	p_con->cursor = p_con->original_addr;
+
+	memset16(CON_CELL(p_con->original_addr), BLANK_CELL, CON_MEM_CELLS);
+	mark_dirty(p_con, p_con->original_addr,
+		   p_con->original_addr + CON_MEM_CELLS);
+
+	p_con->hist.buf   = (u8*)CON_HIST_BASE + nr_tty * CON_HIST_BYTES;
+	p_con->hist.head  = 0;
+	p_con->hist.first = 0;
+	p_con->hist.next  = 0;
+	p_con->hist.view  = 0;
+
+	p_con->snap = (u16*)CON_SNAP_BASE + nr_tty * CON_SNAP_CELLS;
+
+	p_con->attr          = DEFAULT_CHAR_COLOR;
+	p_con->esc_state     = ESC_NONE;
+	p_con->scroll_top    = 0;
+	p_con->scroll_bottom = 0;
+	p_con->edit_base     = 0;
 
 	if (nr_tty == 0) {
-		/* 第一个控制台沿用原来的光标位置 */
-		p_tty->p_console->cursor = disp_pos / 2;
+		/* 第一个控制台沿用原来的光标位置，屏幕上已有的内容也搬过来 */
+		p_con->cursor = disp_pos / 2;
 		disp_pos = 0;
+		memmove16(CON_CELL(p_con->original_addr), (void*)V_MEM_BASE,
+			  SCREEN_SIZE);
 	}
 	else {
 		out_char(p_tty->p_console, nr_tty + '0', 0);
 		out_char(p_tty->p_console, '#', 0);
 	}
 
-	set_cursor(p_tty->p_console->cursor);
+	flush(p_tty->p_console);
 }
 
 
@@ -72,71 +136,1079 @@ PUBLIC int is_current_console(CONSOLE* p_con)
  *======================================================================*/
 PUBLIC void out_char(CONSOLE* p_con, char ch, int color)
 {
-	u8* p_vmem = (u8*)(V_MEM_BASE + p_con->cursor * 2);
-
 	switch(ch) {
 	case '\n':
-		if (p_con->cursor < p_con->original_addr +
-		    p_con->v_mem_limit - SCREEN_WIDTH) {
-			p_con->cursor = p_con->original_addr + SCREEN_WIDTH * 
-				((p_con->cursor - p_con->original_addr) /
-				 SCREEN_WIDTH + 1);
+	case '\b':
+		out_cursor_ctrl(p_con, ch, color);
+		break;
+	default:
+		*CON_CELL(p_con->cursor) = (char_attr(color) << 8) | (u8)ch;
+		mark_dirty(p_con, p_con->cursor, p_con->cursor + 1);
+		p_con->cursor++;
+		if (p_con->scroll_bottom &&
+		    (p_con->cursor - p_con->original_addr) % p_con->width == 0) {
+			wrap_row(p_con);
+		}
+		if (p_con->cursor >=
+		    p_con->original_addr + p_con->v_mem_limit) {
+			wrap_console(p_con);
 		}
 		break;
-	case '\b':
-		if (p_con->cursor > p_con->original_addr) {
-			p_con->cursor--;
-			*(p_vmem-2) = ' ';
-			*(p_vmem-1) = color == 0 ?
-						  DEFAULT_CHAR_COLOR :
-						  	(color == 1 ?
-						  	RED_CHAR_COLOR :
-							  WHITE_BACKGROUND_COLOR);
+	}
+
+	follow_cursor(p_con);
+	flush(p_con);
+}
+
+/*======================================================================*
+			   out_string
+ *----------------------------------------------------------------------*
+ 输出一串字符，效果和逐个调用 out_char 相同，另外还解析 ESC [ 开头的
+ 控制序列(见 csi_dispatch)。color 为 0 时用 SGR 设置的属性。
+ 可显示的字符一段一段地直接写进影子缓冲区，只有 '\n'、'\b' 和 ESC 单独
+ 处理，序列中的字符才交给 esc_byte；滚屏在最后算一次，光标和显示起始
+ 地址也只写一次 CRTC。
+ *======================================================================*/
+PUBLIC void out_string(CONSOLE* p_con, const char* str, int len, int color)
+{
+	const char* end = str + len;
+	unsigned int limit = p_con->original_addr + p_con->v_mem_limit;
+	unsigned int run;
+	u16 attr;
+	u16* p_cell;
+
+	while (str < end) {
+		/* 序列可能跨两次输出 */
+		if (p_con->esc_state != ESC_NONE) {
+			esc_byte(p_con, *str++);
+			continue;
+		}
+
+		switch (*str) {
+		case '\n':
+			line_feed(p_con, color);
+			str++;
+			break;
+		case '\b':
+			out_cursor_ctrl(p_con, *str++, color);
+			break;
+		case 0x1B:
+			p_con->esc_state = ESC_GOT_ESC;
+			str++;
+			break;
+		default:
+			attr = (color ? char_attr(color) : p_con->attr) << 8;
+			run = p_con->cursor;
+			p_cell = CON_CELL(run);
+			while (str < end && *str != '\n' && *str != '\b' &&
+			       *str != 0x1B) {
+				*p_cell++ = attr | (u8)*str++;
+				p_con->cursor++;
+				if (p_con->scroll_bottom &&
+				    (p_con->cursor - p_con->original_addr) %
+				    p_con->width == 0) {
+					mark_dirty(p_con, run, p_con->cursor);
+					wrap_row(p_con);
+					run = p_con->cursor;
+					p_cell = CON_CELL(run);
+				}
+				if (p_con->cursor >= limit) {
+					/* 整个控制台都会被标记，不用再管 run */
+					wrap_console(p_con);
+					run = p_con->cursor;
+					p_cell = CON_CELL(run);
+				}
+			}
+			mark_dirty(p_con, run, p_con->cursor);
+			break;
+		}
+	}
+
+	follow_cursor(p_con);
+	flush(p_con);
+}
+
+/*======================================================================*
+			   line_feed
+ *----------------------------------------------------------------------*
+ '\n'：光标在滚动区域的最后一行时只滚动这个区域，否则同 out_char。
+ *======================================================================*/
+PRIVATE void line_feed(CONSOLE* p_con, int color)
+{
+	if (p_con->scroll_bottom &&
+	    screen_row(p_con, p_con->cursor) == p_con->scroll_bottom - 1) {
+		scroll_region(p_con, p_con->scroll_top, p_con->scroll_bottom, 1);
+		p_con->cursor = p_con->current_start_addr +
+			(p_con->scroll_bottom - 1) * p_con->width;
+	}
+	else {
+		out_cursor_ctrl(p_con, '\n', color);
+	}
+}
+
+/*======================================================================*
+			   wrap_row
+ *----------------------------------------------------------------------*
+ 有滚动区域时，光标写满一行走到下一行的开头之后调用。写满的是区域的
+ 最后一行时只滚动这个区域，光标回到区域最后一行的开头，不跑出区域。
+ *======================================================================*/
+PRIVATE void wrap_row(CONSOLE* p_con)
+{
+	int row = screen_row(p_con, p_con->cursor - 1);
+
+	if (row == p_con->scroll_bottom - 1) {
+		scroll_region(p_con, p_con->scroll_top, p_con->scroll_bottom, 1);
+		p_con->cursor = p_con->current_start_addr + row * p_con->width;
+	}
+}
+
+/*======================================================================*
+			   screen_row
+ *----------------------------------------------------------------------*
+ 滚动屏幕让控制台中的 pos 出现在屏幕上，返回它在屏幕上的第几行。
+ *======================================================================*/
+PRIVATE int screen_row(CONSOLE* p_con, unsigned int pos)
+{
+	if (pos < p_con->current_start_addr) {
+		p_con->current_start_addr = pos -
+			(pos - p_con->original_addr) % p_con->width;
+	}
+	while (pos >= p_con->current_start_addr + p_con->screen_size) {
+		p_con->current_start_addr += p_con->width;
+	}
+	return (pos - p_con->current_start_addr) / p_con->width;
+}
+
+/*======================================================================*
+			   esc_byte
+ *----------------------------------------------------------------------*
+ ESC 之后的字符一个一个地交给这里。只认 ESC [ 参数 终止符 这一种序列，
+ 别的序列连同 ESC 后面的那个字符一起丢掉。
+ *======================================================================*/
+PRIVATE void esc_byte(CONSOLE* p_con, char ch)
+{
+	int i;
+
+	if (p_con->esc_state == ESC_GOT_ESC) {
+		if (ch == '[') {
+			p_con->esc_state = ESC_CSI;
+			p_con->esc_nr_params = 0;
+			for (i = 0; i < ESC_MAX_PARAMS; i++) {
+				p_con->esc_params[i] = 0;
+			}
+		}
+		else {
+			p_con->esc_state = ESC_NONE;
 		}
+		return;
+	}
+
+	if (ch >= '0' && ch <= '9') {
+		if (p_con->esc_nr_params == 0) {
+			p_con->esc_nr_params = 1;
+		}
+		i = p_con->esc_nr_params - 1;
+		if (p_con->esc_params[i] < 10000) {
+			p_con->esc_params[i] = p_con->esc_params[i] * 10 +
+				(ch - '0');
+		}
+	}
+	else if (ch == ';') {
+		if (p_con->esc_nr_params == 0) {
+			p_con->esc_nr_params = 1;
+		}
+		if (p_con->esc_nr_params < ESC_MAX_PARAMS) {
+			p_con->esc_nr_params++;
+		}
+	}
+	else if (ch >= 0x40 && ch <= 0x7E) {
+		p_con->esc_state = ESC_NONE;
+		csi_dispatch(p_con, ch);
+	}
+	/* '?' 之类的其它字符不管 */
+}
+
+/*======================================================================*
+			   csi_dispatch
+ *----------------------------------------------------------------------*
+ 执行一个 CSI 序列，行和列都在当前屏幕上算：
+	A B C D	光标上下右左移动		H f	光标定位(行;列，从 1 开始)
+	J	清屏(0 到屏幕末尾 1 到屏幕开头 2 整屏)
+	K	清行(0 到行尾 1 到行首 2 整行)
+	m	SGR 颜色			r	设置滚动区域(上;下)
+	S T	滚动区域向上/向下滚
+ *======================================================================*/
+PRIVATE void csi_dispatch(CONSOLE* p_con, char final)
+{
+	int* param = p_con->esc_params;
+	int n = p_con->esc_nr_params;
+	int arg = (n > 0 && param[0]) ? param[0] : 1;
+	int top = p_con->scroll_bottom ? p_con->scroll_top : 0;
+	int bottom = p_con->scroll_bottom ? p_con->scroll_bottom :
+		p_con->height;
+	unsigned int base;
+	unsigned int pos;
+	int row;
+	int col;
+
+	/* 先让光标回到屏幕上，行列才好算 */
+	row = screen_row(p_con, p_con->cursor);
+	base = p_con->current_start_addr - p_con->original_addr;
+	pos = p_con->cursor - p_con->current_start_addr;
+	col = pos % p_con->width;
+
+	switch (final) {
+	case 'A':
+		row -= arg;
 		break;
-	default:
-		if (p_con->cursor <
-		    p_con->original_addr + p_con->v_mem_limit - 1) {
-			*p_vmem++ = ch;
-			*p_vmem++ = color == 0 ?
-						DEFAULT_CHAR_COLOR :
-						  	(color == 1 ?
-						  	RED_CHAR_COLOR :
-							  WHITE_BACKGROUND_COLOR);
-			p_con->cursor++;
+	case 'B':
+		row += arg;
+		break;
+	case 'C':
+		col += arg;
+		break;
+	case 'D':
+		col -= arg;
+		break;
+	case 'H':
+	case 'f':
+		row = arg - 1;
+		col = (n > 1 && param[1]) ? param[1] - 1 : 0;
+		break;
+	case 'J':
+		if (param[0] == 0) {
+			fill_region(p_con, base + pos, p_con->screen_size - pos, ' ', 0);
+		}
+		else if (param[0] == 1) {
+			fill_region(p_con, base, pos + 1, ' ', 0);
 		}
+		else if (param[0] == 2) {
+			fill_region(p_con, base, p_con->screen_size, ' ', 0);
+		}
+		break;
+	case 'K':
+		if (param[0] == 0) {
+			fill_region(p_con, base + pos, p_con->width - col, ' ', 0);
+		}
+		else if (param[0] == 1) {
+			fill_region(p_con, base + row * p_con->width, col + 1,
+				    ' ', 0);
+		}
+		else if (param[0] == 2) {
+			fill_region(p_con, base + row * p_con->width,
+				    p_con->width, ' ', 0);
+		}
+		break;
+	case 'm':
+		csi_sgr(p_con);
+		break;
+	case 'r':
+		top = arg - 1;
+		bottom = (n > 1 && param[1]) ? param[1] : p_con->height;
+		if (top < bottom - 1 && bottom <= p_con->height &&
+		    !(top == 0 && bottom == p_con->height)) {
+			p_con->scroll_top = top;
+			p_con->scroll_bottom = bottom;
+		}
+		else {
+			p_con->scroll_bottom = 0;
+		}
+		row = 0;
+		col = 0;
+		break;
+	case 'S':
+		scroll_region(p_con, top, bottom, arg);
+		break;
+	case 'T':
+		scroll_region(p_con, top, bottom, -arg);
+		break;
+	default:
 		break;
 	}
 
-	while (p_con->cursor >= p_con->current_start_addr + SCREEN_SIZE) {
-		scroll_screen(p_con, SCR_DN);
+	if (row < 0) {
+		row = 0;
+	}
+	if (row >= p_con->height) {
+		row = p_con->height - 1;
+	}
+	if (col < 0) {
+		col = 0;
 	}
+	if (col >= p_con->width) {
+		col = p_con->width - 1;
+	}
+	p_con->cursor = p_con->current_start_addr + row * p_con->width + col;
+}
+
+/*======================================================================*
+			   csi_sgr
+ *----------------------------------------------------------------------*
+ ESC [ ... m：0 恢复默认 1 加亮 22 取消加亮 7 反色 30~37 前景色
+ 39 默认前景色 40~47 背景色 49 默认背景色 90~97 加亮的前景色
+ *======================================================================*/
+PRIVATE void csi_sgr(CONSOLE* p_con)
+{
+	int n = p_con->esc_nr_params ? p_con->esc_nr_params : 1;
+	u8 attr = p_con->attr;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		int p = p_con->esc_params[i];
 
+		if (p == 0) {
+			attr = DEFAULT_CHAR_COLOR;
+		}
+		else if (p == 1) {
+			attr |= 0x08;
+		}
+		else if (p == 22) {
+			attr &= ~0x08;
+		}
+		else if (p == 7) {
+			attr = (attr << 4) | (attr >> 4);
+		}
+		else if (p >= 30 && p <= 37) {
+			attr = (attr & 0xF8) | ansi_color[p - 30];
+		}
+		else if (p == 39) {
+			attr = (attr & 0xF8) | (DEFAULT_CHAR_COLOR & 0x07);
+		}
+		else if (p >= 40 && p <= 47) {
+			attr = (attr & 0x8F) | (ansi_color[p - 40] << 4);
+		}
+		else if (p == 49) {
+			attr = (attr & 0x8F) | (DEFAULT_CHAR_COLOR & 0x70);
+		}
+		else if (p >= 90 && p <= 97) {
+			attr = (attr & 0xF0) | 0x08 | ansi_color[p - 90];
+		}
+	}
+
+	p_con->attr = attr;
+}
+
+/*======================================================================*
+			   follow_cursor
+ *----------------------------------------------------------------------*
+ 光标跑到屏幕下面时往后滚，直到光标在最后一行。
+ *======================================================================*/
+PRIVATE void follow_cursor(CONSOLE* p_con)
+{
+	while (p_con->cursor >= p_con->current_start_addr + p_con->screen_size &&
+	       p_con->current_start_addr + p_con->screen_size <=
+	       p_con->original_addr + p_con->v_mem_limit - p_con->width) {
+		p_con->current_start_addr += p_con->width;
+	}
+}
+
+/*======================================================================*
+			   out_cursor_ctrl
+ *----------------------------------------------------------------------*
+ 处理 '\n' 和 '\b'，规则同 out_char，但不滚屏也不写 CRTC。
+ *======================================================================*/
+PRIVATE void out_cursor_ctrl(CONSOLE* p_con, char ch, int color)
+{
+	if (ch == '\n') {
+		if (p_con->cursor >= p_con->original_addr +
+		    p_con->v_mem_limit - p_con->width) {
+			wrap_console(p_con);
+		}
+		p_con->cursor = p_con->original_addr + p_con->width *
+			((p_con->cursor - p_con->original_addr) /
+			 p_con->width + 1);
+	}
+	else if (p_con->cursor > p_con->original_addr) {
+		p_con->cursor--;
+		*CON_CELL(p_con->cursor) = (char_attr(color) << 8) | ' ';
+		mark_dirty(p_con, p_con->cursor, p_con->cursor + 1);
+	}
+}
+
+/*======================================================================*
+			   blit_screen
+ *----------------------------------------------------------------------*
+ 切换控制台时用：一次把整个屏幕从影子缓冲区复制到显存。
+ *======================================================================*/
+PRIVATE void blit_screen(CONSOLE* p_con)
+{
+	int row = (p_con->current_start_addr - p_con->original_addr) /
+		p_con->width;
+	int last = row + p_con->height;
+
+	for (; row < last; row++) {
+		p_con->dirty[row >> 5] &= ~(1 << (row & 31));
+	}
+	memmove16((u16*)V_MEM_BASE +
+		  (p_con->current_start_addr - p_con->original_addr),
+		  CON_CELL(p_con->current_start_addr), p_con->screen_size);
+}
+
+/*======================================================================*
+			   wrap_console
+ *----------------------------------------------------------------------*
+ 光标到了控制台的最后一行之后，把最后一屏(少一行)的格子
+ 一次搬回控制台开头，其余清空，光标跟着搬，显示起始地址回到开头。
+ 被挤掉的行存进历史记录。每写满一遍控制台才做一次，平均到每一行是常数。
+ *======================================================================*/
+PRIVATE void wrap_console(CONSOLE* p_con)
+{
+	unsigned int keep = p_con->screen_size - p_con->width;
+
+	shift_console(p_con, p_con->v_mem_limit - keep);
+	p_con->current_start_addr = p_con->original_addr;
+}
+
+/*======================================================================*
+			   push_rows
+ *----------------------------------------------------------------------*
+ 把控制台开头的 rows 行挤进历史记录，下面的内容往上搬，给后面腾出地方。
+ 屏幕跟着内容一起往上，到开头为止。
+ *======================================================================*/
+PUBLIC void push_rows(CONSOLE* p_con, int rows)
+{
+	unsigned int shift = rows * p_con->width;
+
+	if (rows <= 0 || rows >= p_con->nr_rows) {
+		return;
+	}
+
+	shift_console(p_con, shift);
+	if (p_con->current_start_addr >= p_con->original_addr + shift) {
+		p_con->current_start_addr -= shift;
+	}
+	else {
+		p_con->current_start_addr = p_con->original_addr;
+	}
 	flush(p_con);
 }
 
+/*======================================================================*
+			   shift_console
+ *----------------------------------------------------------------------*
+ 控制台开头的 shift 个格子(整行)存进历史记录，其余的搬到开头，后面空出来
+ 的清空。光标和编辑区跟着搬，显示起始地址由调用者放好。
+ *======================================================================*/
+PRIVATE void shift_console(CONSOLE* p_con, unsigned int shift)
+{
+	HISTORY* h = &p_con->hist;
+	unsigned int keep = p_con->v_mem_limit - shift;
+	unsigned int pos;
+
+	for (pos = 0; pos < shift; pos += p_con->width) {
+		hist_push(h, CON_CELL(p_con->original_addr + pos), p_con->width);
+	}
+	/* 正在看历史的话，屏幕上的内容不变 */
+	if (h->view) {
+		h->view += shift / p_con->width;
+		if (h->view > (int)(h->next - h->first)) {
+			h->view = h->next - h->first;
+		}
+	}
+
+	memmove16(CON_CELL(p_con->original_addr),
+		  CON_CELL(p_con->original_addr + shift), keep);
+	memset16(CON_CELL(p_con->original_addr + keep), BLANK_CELL, shift);
+	mark_dirty(p_con, p_con->original_addr,
+		   p_con->original_addr + p_con->v_mem_limit);
+
+	p_con->cursor -= shift;
+	p_con->edit_base -= (int)shift;
+}
+
+/*======================================================================*
+			   hist_push
+ *----------------------------------------------------------------------*
+ 把一行(width 个格子)压缩后存进历史记录，空间不够时丢掉最旧的行。
+ *======================================================================*/
+PRIVATE void hist_push(HISTORY* h, u16* row, int width)
+{
+	u32 mask = CON_HIST_BYTES - 1;
+	int n = width;
+	int i;
+	int run;
+	u32 nr_runs_at;
+	u8 nr_runs = 0;
+
+	while (n > 0 && row[n - 1] == BLANK_CELL) {
+		n--;
+	}
+
+	h->line[h->next % CON_HIST_LINES] = h->head;
+	h->next++;
+
+	h->buf[h->head++ & mask] = n;
+	for (i = 0; i < n; i++) {
+		h->buf[h->head++ & mask] = row[i] & 0xFF;
+	}
+
+	nr_runs_at = h->head++;
+	for (i = 0; i < n; i += run) {
+		u8 attr = row[i] >> 8;
+
+		for (run = 1; i + run < n && (row[i + run] >> 8) == attr; run++) {
+		}
+		h->buf[h->head++ & mask] = run;
+		h->buf[h->head++ & mask] = attr;
+		nr_runs++;
+	}
+	h->buf[nr_runs_at & mask] = nr_runs;
+
+	while (h->next - h->first > CON_HIST_LINES ||
+	       h->head - h->line[h->first % CON_HIST_LINES] > CON_HIST_BYTES) {
+		h->first++;
+	}
+}
+
+/*======================================================================*
+			   hist_line
+ *----------------------------------------------------------------------*
+ 把第 nr 个历史行解压到 row 中，行尾补空白。
+ *======================================================================*/
+PRIVATE void hist_line(HISTORY* h, u32 nr, u16* row, int width)
+{
+	u32 mask = CON_HIST_BYTES - 1;
+	u32 off = h->line[nr % CON_HIST_LINES];
+	int n = h->buf[off++ & mask];
+	int nr_runs;
+	int i;
+	int j;
+
+	/* 比现在的屏幕宽的行截掉后面的部分 */
+	for (i = 0; i < n; i++, off++) {
+		if (i < width) {
+			row[i] = h->buf[off & mask];
+		}
+	}
+	nr_runs = h->buf[off++ & mask];
+	for (i = 0; nr_runs > 0; nr_runs--) {
+		int run = h->buf[off++ & mask];
+		u16 attr = h->buf[off++ & mask] << 8;
+
+		for (j = 0; j < run; j++, i++) {
+			if (i < width) {
+				row[i] |= attr;
+			}
+		}
+	}
+	for (; i < width; i++) {
+		row[i] = BLANK_CELL;
+	}
+}
+
+/*======================================================================*
+			   draw_history
+ *----------------------------------------------------------------------*
+ 正在看历史时，把屏幕上的各行直接画到显存的开头。
+ *======================================================================*/
+PRIVATE void draw_history(CONSOLE* p_con)
+{
+	HISTORY* h = &p_con->hist;
+	u16* p_vmem = (u16*)V_MEM_BASE;
+	int line = -h->view;
+	int row;
+
+	for (row = 0; row < p_con->height; row++, line++) {
+		if (line < 0) {
+			hist_line(h, h->next + line, p_vmem + row * p_con->width,
+				  p_con->width);
+		}
+		else {
+			memmove16(p_vmem + row * p_con->width,
+				  CON_CELL(p_con->original_addr +
+					   line * p_con->width),
+				  p_con->width);
+		}
+	}
+}
+
+/*======================================================================*
+			   view_top
+ *----------------------------------------------------------------------*
+ 屏幕顶上的行：负数是倒数第几个历史行，否则是控制台中的第几行。
+ *======================================================================*/
+PRIVATE int view_top(CONSOLE* p_con)
+{
+	if (p_con->hist.view) {
+		return -p_con->hist.view;
+	}
+	return (p_con->current_start_addr - p_con->original_addr) /
+		p_con->width;
+}
+
+/*======================================================================*
+			   scroll_history
+ *----------------------------------------------------------------------*
+ 向后(lines > 0)或向前(lines < 0)翻 lines 行，可以一直翻到最旧的历史行。
+ *======================================================================*/
+PUBLIC void scroll_history(CONSOLE* p_con, int lines)
+{
+	HISTORY* h = &p_con->hist;
+	int top = view_top(p_con) + lines;
+	int oldest = -(int)(h->next - h->first);
+	int last = p_con->nr_rows - p_con->height;
+
+	if (top < oldest) {
+		top = oldest;
+	}
+	if (top > last) {
+		top = last;
+	}
+
+	if (top < 0) {
+		/* 先置上 view，console_tick 就不会再往显存里复制 */
+		h->view = -top;
+		if (is_current_console(p_con)) {
+			draw_history(p_con);
+		}
+	}
+	else {
+		if (h->view) {
+			h->view = 0;
+			mark_dirty(p_con, p_con->original_addr,
+				   p_con->original_addr + p_con->v_mem_limit);
+		}
+		p_con->current_start_addr = p_con->original_addr +
+			top * p_con->width;
+	}
+
+	flush(p_con);
+}
+
+/*======================================================================*
+			   scroll_live
+ *----------------------------------------------------------------------*
+ 回到光标所在的地方。
+ *======================================================================*/
+PUBLIC void scroll_live(CONSOLE* p_con)
+{
+	int row = (p_con->cursor - p_con->original_addr) / p_con->width;
+	int top = (row < p_con->height) ? 0 : row - (p_con->height - 1);
+
+	scroll_history(p_con, top - view_top(p_con));
+}
+
+/*======================================================================*
+			   save_screen
+ *----------------------------------------------------------------------*
+ 保存屏幕上的格子、光标和显示起始地址，以后用 restore_screen 恢复。
+ *======================================================================*/
+PUBLIC void save_screen(CONSOLE* p_con)
+{
+	memmove16(p_con->snap, CON_CELL(p_con->current_start_addr),
+		  p_con->screen_size);
+	p_con->snap_start = p_con->current_start_addr;
+	p_con->snap_cursor = p_con->cursor;
+}
+
+/*======================================================================*
+			   restore_screen
+ *----------------------------------------------------------------------*
+ 一次复制恢复 save_screen 保存的屏幕。保存之后只能改这一屏中的格子，
+ 屏幕外面改了的恢复不了。
+ *======================================================================*/
+PUBLIC void restore_screen(CONSOLE* p_con)
+{
+	unsigned int end = p_con->snap_start + p_con->screen_size;
+
+	p_con->current_start_addr = p_con->snap_start;
+	p_con->cursor = p_con->snap_cursor;
+	memmove16(CON_CELL(p_con->current_start_addr), p_con->snap,
+		  p_con->screen_size);
+	mark_dirty(p_con, p_con->current_start_addr, end);
+
+	flush(p_con);
+}
+
+/*======================================================================*
+			   set_char_color
+ *----------------------------------------------------------------------*
+ 只改控制台中第 pos 个字符的颜色，不动字符和光标。color 的含义同 out_char。
+ *======================================================================*/
+PUBLIC void set_char_color(CONSOLE* p_con, unsigned int pos, int color)
+{
+	u8* p_cell = (u8*)CON_CELL(p_con->original_addr + pos);
+
+	*(p_cell + 1) = char_attr(color);
+	mark_dirty(p_con, p_con->original_addr + pos,
+		   p_con->original_addr + pos + 1);
+}
+
+/*======================================================================*
+			   char_attr
+ *----------------------------------------------------------------------*
+ color: 0 普通  1 红字  2 白底
+ *======================================================================*/
+PRIVATE u8 char_attr(int color)
+{
+	return color == 0 ?
+		DEFAULT_CHAR_COLOR :
+		(color == 1 ?
+		RED_CHAR_COLOR :
+		WHITE_BACKGROUND_COLOR);
+}
+
+/*======================================================================*
+			   fill_region
+ *----------------------------------------------------------------------*
+ 把控制台中从 pos 开始的 len 个格子都写成 ch，颜色为 color。
+ pos 从控制台的开头算起，超出控制台的部分被忽略。不动光标。
+ *======================================================================*/
+PUBLIC void fill_region(CONSOLE* p_con, unsigned int pos, unsigned int len,
+			char ch, int color)
+{
+	u16 cell = (char_attr(color) << 8) | (u8)ch;
+
+	if (pos >= p_con->v_mem_limit) {
+		return;
+	}
+	if (len > p_con->v_mem_limit - pos) {
+		len = p_con->v_mem_limit - pos;
+	}
+
+	memset16(CON_CELL(p_con->original_addr + pos), cell, len);
+	mark_dirty(p_con, p_con->original_addr + pos,
+		   p_con->original_addr + pos + len);
+}
+
+/*======================================================================*
+			   copy_region
+ *----------------------------------------------------------------------*
+ 把控制台中从 src 开始的 len 个格子复制到 dst，两块可以重叠。不动光标。
+ *======================================================================*/
+PUBLIC void copy_region(CONSOLE* p_con, unsigned int dst, unsigned int src,
+			unsigned int len)
+{
+	unsigned int far = (dst > src) ? dst : src;
+
+	if (far >= p_con->v_mem_limit) {
+		return;
+	}
+	if (len > p_con->v_mem_limit - far) {
+		len = p_con->v_mem_limit - far;
+	}
+
+	memmove16(CON_CELL(p_con->original_addr + dst),
+		  CON_CELL(p_con->original_addr + src), len);
+	mark_dirty(p_con, p_con->original_addr + dst,
+		   p_con->original_addr + dst + len);
+}
+
+/*======================================================================*
+			   scroll_region
+ *----------------------------------------------------------------------*
+ 把当前屏幕上 [top, bottom) 这几行的内容向上滚 lines 行(lines 为负数时
+ 向下滚)，空出来的行填成空白。屏幕外的内容和光标都不变。
+ *======================================================================*/
+PUBLIC void scroll_region(CONSOLE* p_con, int top, int bottom, int lines)
+{
+	unsigned int base = p_con->current_start_addr - p_con->original_addr;
+	int n = (lines > 0) ? lines : -lines;
+
+	if (top < 0 || bottom > p_con->height || top >= bottom ||
+	    lines == 0) {
+		return;
+	}
+	if (n > bottom - top) {
+		n = bottom - top;
+	}
+
+	if (lines > 0) {
+		copy_region(p_con, base + top * p_con->width,
+			    base + (top + n) * p_con->width,
+			    (bottom - top - n) * p_con->width);
+		fill_region(p_con, base + (bottom - n) * p_con->width,
+			    n * p_con->width, ' ', 0);
+	}
+	else {
+		copy_region(p_con, base + (top + n) * p_con->width,
+			    base + top * p_con->width,
+			    (bottom - top - n) * p_con->width);
+		fill_region(p_con, base + top * p_con->width,
+			    n * p_con->width, ' ', 0);
+	}
+}
+
+/*======================================================================*
+			   clear_console
+ *----------------------------------------------------------------------*
+ 清空整个控制台，光标、显示起始地址和编辑区回到开头，各写一次 CRTC。
+ *======================================================================*/
+PUBLIC void clear_console(CONSOLE* p_con)
+{
+	fill_region(p_con, 0, p_con->v_mem_limit, ' ', 0);
+
+	p_con->cursor = p_con->original_addr;
+	p_con->current_start_addr = p_con->original_addr;
+	p_con->edit_base = 0;
+	flush(p_con);
+}
+
+/*======================================================================*
+			   render_begin
+ *----------------------------------------------------------------------*
+ 从控制台中的 pos 开始重新画(pos 从控制台开头算起)。之后用 render_char
+ 按 out_char 的排版规则依次给出要画的内容，最后调用 render_end。
+ 只有和屏幕上现有内容不同的格子才会被写，字符相同只是颜色不同时只写
+ 属性字节。光标不动，由调用者用 set_cursor_pos 放好。
+ *======================================================================*/
+PUBLIC void render_begin(CONSOLE* p_con, unsigned int pos)
+{
+	if (pos > p_con->v_mem_limit - 1) {
+		pos = p_con->v_mem_limit - 1;
+	}
+	p_con->render_pos = p_con->original_addr + pos;
+}
+
+/*======================================================================*
+			   render_char
+ *======================================================================*/
+PUBLIC void render_char(CONSOLE* p_con, char ch, int color)
+{
+	unsigned int line_end;
+
+	if (ch == '\n') {
+		/* 换行跳过的格子在这一帧里是空白。最后一行的换行到了控制台
+		 * 的末尾，之后的内容都画不下了
+		 */
+		line_end = p_con->original_addr + p_con->width *
+			((p_con->render_pos - p_con->original_addr) /
+			 p_con->width + 1);
+		if (line_end > p_con->original_addr + p_con->v_mem_limit - 1) {
+			line_end = p_con->original_addr + p_con->v_mem_limit - 1;
+		}
+		while (p_con->render_pos < line_end) {
+			render_cell(p_con, p_con->render_pos++, ' ',
+				    DEFAULT_CHAR_COLOR);
+		}
+	}
+	else if (p_con->render_pos <
+		 p_con->original_addr + p_con->v_mem_limit - 1) {
+		render_cell(p_con, p_con->render_pos++, ch, char_attr(color));
+	}
+}
+
+/*======================================================================*
+			   render_end
+ *----------------------------------------------------------------------*
+ 擦掉画完的位置到 clear_to 之间原来的内容(上一次画得比这次长的部分)，
+ 返回画完的位置。两个位置都从控制台开头算起。
+ *======================================================================*/
+PUBLIC unsigned int render_end(CONSOLE* p_con, unsigned int clear_to)
+{
+	unsigned int pos;
+
+	for (pos = p_con->render_pos;
+	     pos < p_con->original_addr + clear_to &&
+	     pos < p_con->original_addr + p_con->v_mem_limit; pos++) {
+		render_cell(p_con, pos, ' ', DEFAULT_CHAR_COLOR);
+	}
+
+	return p_con->render_pos - p_con->original_addr;
+}
+
+/*======================================================================*
+			   set_cursor_pos
+ *----------------------------------------------------------------------*
+ 把光标放到控制台中的 pos，光标不在屏幕上时滚动到能看见它。
+ *======================================================================*/
+PUBLIC void set_cursor_pos(CONSOLE* p_con, unsigned int pos)
+{
+	if (pos > p_con->v_mem_limit - 1) {
+		pos = p_con->v_mem_limit - 1;
+	}
+	p_con->cursor = p_con->original_addr + pos;
+
+	if (p_con->cursor < p_con->current_start_addr) {
+		p_con->current_start_addr = p_con->original_addr +
+			pos / p_con->width * p_con->width;
+	}
+	follow_cursor(p_con);
+	flush(p_con);
+}
+
+/*======================================================================*
+			   render_cell
+ *======================================================================*/
+PRIVATE void render_cell(CONSOLE* p_con, unsigned int pos, char ch, u8 attr)
+{
+	u8* p_cell = (u8*)CON_CELL(pos);
+
+	if (*p_cell != (u8)ch) {
+		*p_cell = ch;
+		*(p_cell + 1) = attr;
+	}
+	else if (*(p_cell + 1) != attr) {
+		*(p_cell + 1) = attr;
+	}
+	else {
+		return;
+	}
+	mark_dirty(p_con, pos, pos + 1);
+}
+
+/*======================================================================*
+			   mark_dirty
+ *----------------------------------------------------------------------*
+ 影子缓冲区中 [from, to) 这些格子变了，记下它们所在的行。
+ 先写格子再置位，blit_dirty_rows 先清位再复制，所以不会漏掉更新。
+ *======================================================================*/
+PRIVATE void mark_dirty(CONSOLE* p_con, unsigned int from, unsigned int to)
+{
+	int row;
+	int last;
+
+	if (from >= to) {
+		return;
+	}
+
+	row = (from - p_con->original_addr) / p_con->width;
+	last = (to - 1 - p_con->original_addr) / p_con->width;
+	for (; row <= last; row++) {
+		p_con->dirty[row >> 5] |= 1 << (row & 31);
+	}
+}
+
+/*======================================================================*
+			   blit_dirty_rows
+ *----------------------------------------------------------------------*
+ 把当前屏幕上需要更新的行从影子缓冲区复制到显存。
+ 屏幕之外的行留着，滚到屏幕上时再复制。
+ *======================================================================*/
+PRIVATE void blit_dirty_rows(CONSOLE* p_con)
+{
+	int row = (p_con->current_start_addr - p_con->original_addr) /
+		p_con->width;
+	int last = row + p_con->height;
+	u32 bit;
+
+	/* 在看历史时显存里是 draw_history 画的 */
+	if (p_con->hist.view) {
+		return;
+	}
+
+	if (last > p_con->nr_rows) {
+		last = p_con->nr_rows;
+	}
+
+	for (; row < last; row++) {
+		bit = 1 << (row & 31);
+		if (p_con->dirty[row >> 5] & bit) {
+			p_con->dirty[row >> 5] &= ~bit;
+			memmove16((u16*)V_MEM_BASE + row * p_con->width,
+				  CON_CELL(p_con->original_addr +
+					   row * p_con->width),
+				  p_con->width);
+		}
+	}
+}
+
 /*======================================================================*
                            flush
+ *----------------------------------------------------------------------*
+ 只记下当前控制台想要的光标和显示起始地址(换算成显存中的位置)，
+ 真正写 CRTC 的是 console_tick 或 console_sync。
+ 看历史时显示显存的开头，光标放到屏幕外面藏起来。
 *======================================================================*/
 PRIVATE void flush(CONSOLE* p_con)
 {
-	if (is_current_console(p_con)) {
-		set_cursor(p_con->cursor);
-		set_video_start_addr(p_con->current_start_addr);
+	if (!is_current_console(p_con)) {
+		return;
+	}
+
+	if (p_con->hist.view) {
+		crtc.want_cursor = p_con->screen_size;
+		crtc.want_start = 0;
+	}
+	else {
+		crtc.want_cursor = p_con->cursor - p_con->original_addr;
+		crtc.want_start = p_con->current_start_addr -
+			p_con->original_addr;
+	}
+	crtc.dirty = 1;
+	crtc.requests++;
+}
+
+/*======================================================================*
+                           console_tick
+ *----------------------------------------------------------------------*
+ 由 clock_handler 每个 tick 调用一次：把当前控制台变了的行复制到显存，
+ 再更新 CRTC。一个 tick 之内的输出不管有多少，都只复制一次。
+*======================================================================*/
+PUBLIC void console_tick()
+{
+	CONSOLE* p_con = &console_table[nr_current_console];
+
+	/* 时钟中断比 init_screen 来得早，控制台还没有大小时什么也不做 */
+	if (p_con->width == 0 || p_con->v_mem_limit == 0) {
+		return;
+	}
+
+	blit_dirty_rows(p_con);
+
+	if (crtc.dirty) {
+		crtc_apply();
 	}
 }
 
+/*======================================================================*
+                           console_sync
+ *----------------------------------------------------------------------*
+ 立即更新显存和 CRTC，不等下一个 tick。
+*======================================================================*/
+PUBLIC void console_sync()
+{
+	u32 flags = disable_int_save();
+
+	blit_dirty_rows(&console_table[nr_current_console]);
+	crtc_apply();
+	restore_int(flags);
+}
+
+/*======================================================================*
+                           crtc_apply
+*======================================================================*/
+PRIVATE void crtc_apply()
+{
+	/* 先清 dirty 再取值，取值之后的 flush 会重新置位，留到下一次 */
+	crtc.dirty = 0;
+
+	if (crtc.want_cursor != crtc.cursor) {
+		crtc.cursor = crtc.want_cursor;
+		set_cursor(crtc.cursor);
+		crtc.port_writes += 4;
+	}
+	if (crtc.want_start != crtc.start) {
+		crtc.start = crtc.want_start;
+		set_video_start_addr(crtc.start);
+		crtc.port_writes += 4;
+	}
+}
+
+/*======================================================================*
+                           get_crtc_stat
+ *----------------------------------------------------------------------*
+ p_writes: 实际写了多少次端口
+ p_saved : 和每次 flush 都写光标和起始地址相比，少写了多少次
+*======================================================================*/
+PUBLIC void get_crtc_stat(u32* p_writes, u32* p_saved)
+{
+	*p_writes = crtc.port_writes;
+	*p_saved = crtc.requests * 8 - crtc.port_writes;
+}
+
 /*======================================================================*
 			    set_cursor
  *======================================================================*/
 PRIVATE void set_cursor(unsigned int position)
 {
-	disable_int();
+	u32 flags = disable_int_save();
+
 	out_byte(CRTC_ADDR_REG, CURSOR_H);
 	out_byte(CRTC_DATA_REG, (position >> 8) & 0xFF);
 	out_byte(CRTC_ADDR_REG, CURSOR_L);
 	out_byte(CRTC_DATA_REG, position & 0xFF);
-	enable_int();
+	restore_int(flags);
 }
 
 /*======================================================================*
@@ -144,12 +1216,13 @@ PRIVATE void set_cursor(unsigned int position)
  *======================================================================*/
 PRIVATE void set_video_start_addr(u32 addr)
 {
-	disable_int();
+	u32 flags = disable_int_save();
+
 	out_byte(CRTC_ADDR_REG, START_ADDR_H);
 	out_byte(CRTC_DATA_REG, (addr >> 8) & 0xFF);
 	out_byte(CRTC_ADDR_REG, START_ADDR_L);
 	out_byte(CRTC_DATA_REG, addr & 0xFF);
-	enable_int();
+	restore_int(flags);
 }
 
 
@@ -159,13 +1232,97 @@ PRIVATE void set_video_start_addr(u32 addr)
  *======================================================================*/
 PUBLIC void select_console(int nr_console)	/* 0 ~ (NR_CONSOLES - 1) */
 {
+	CONSOLE* p_con;
+
 	if ((nr_console < 0) || (nr_console >= NR_CONSOLES)) {
 		return;
 	}
 
+	/* 还没有打开(init_screen)的控制台不能切换过去 */
+	p_con = &console_table[nr_console];
+	if (p_con->v_mem_limit == 0) {
+		return;
+	}
+
+	/* 显存里是别的控制台的内容：屏幕上的部分一次复制过去，其余的行
+	 * 等滚到屏幕上时再复制 */
+	memset((void*)p_con->dirty, 0xFF, sizeof(p_con->dirty));
 	nr_current_console = nr_console;
+	use_vga_mode(p_con->mode);
+	if (p_con->hist.view) {
+		draw_history(p_con);
+	}
+	else {
+		blit_screen(p_con);
+	}
 
-	flush(&console_table[nr_console]);
+	/* 切换控制台要马上看到 */
+	flush(p_con);
+	console_sync();
+}
+
+/*======================================================================*
+			   set_console_mode
+ *----------------------------------------------------------------------*
+ 把控制台换成 mode(CON_MODE_80x25 等)的大小。控制台的内容清空，
+ 历史记录保留，当前控制台的话显卡也跟着切换。
+ *======================================================================*/
+PUBLIC void set_console_mode(CONSOLE* p_con, int mode)
+{
+	if (mode < 0 || mode >= NR_CON_MODES) {
+		return;
+	}
+
+	set_geometry(p_con, mode);
+	p_con->cursor = p_con->original_addr;
+	p_con->current_start_addr = p_con->original_addr;
+	p_con->hist.view = 0;
+	p_con->scroll_bottom = 0;
+	p_con->edit_base = 0;
+	memset16(CON_CELL(p_con->original_addr), BLANK_CELL, CON_MEM_CELLS);
+	mark_dirty(p_con, p_con->original_addr,
+		   p_con->original_addr + p_con->v_mem_limit);
+
+	if (is_current_console(p_con)) {
+		use_vga_mode(mode);
+		blit_screen(p_con);
+		flush(p_con);
+		console_sync();
+	}
+}
+
+/*======================================================================*
+			   set_geometry
+ *----------------------------------------------------------------------*
+ 按 mode 设置控制台的列数、行数和占的格子数。
+ *======================================================================*/
+PRIVATE void set_geometry(CONSOLE* p_con, int mode)
+{
+	p_con->mode        = mode;
+	p_con->width       = con_geometry[mode][0];
+	p_con->height      = con_geometry[mode][1];
+	p_con->screen_size = p_con->width * p_con->height;
+	p_con->nr_rows     = CON_MEM_CELLS / p_con->width;
+	p_con->v_mem_limit = p_con->nr_rows * p_con->width;
+}
+
+/*======================================================================*
+			   use_vga_mode
+ *----------------------------------------------------------------------*
+ 显卡的模式和 mode 不同时才切换。切换会清掉 CRTC 中的光标和显示起始
+ 地址，所以下次一定要重写。
+ *======================================================================*/
+PRIVATE void use_vga_mode(int mode)
+{
+	if (mode == vga_mode) {
+		return;
+	}
+
+	vga_set_mode(mode);
+	vga_mode = mode;
+	crtc.cursor = -1;
+	crtc.start = -1;
+	crtc.dirty = 1;
 }
 
 /*======================================================================*
@@ -181,19 +1338,12 @@ PUBLIC void select_console(int nr_console)	/* 0 ~ (NR_CONSOLES - 1) */
 PUBLIC void scroll_screen(CONSOLE* p_con, int direction)
 {
 	if (direction == SCR_UP) {
-		if (p_con->current_start_addr > p_con->original_addr) {
-			p_con->current_start_addr -= SCREEN_WIDTH;
-		}
+		scroll_history(p_con, -1);
 	}
 	else if (direction == SCR_DN) {
-		if (p_con->current_start_addr + SCREEN_SIZE <
-		    p_con->original_addr + p_con->v_mem_limit) {
-			p_con->current_start_addr += SCREEN_WIDTH;
-		}
+		scroll_history(p_con, 1);
 	}
 	else{
 	}
-
-	flush(p_con);
 }
 
@@ -12,6 +12,7 @@
 #include "protect.h"
 #include "tty.h"
 #include "console.h"
+#include "serial.h"
 #include "proc.h"
 #include "global.h"
 #include "proto.h"
@@ -31,6 +32,7 @@ PUBLIC char task_stack[STACK_SIZE_TOTAL];
 
 PUBLIC TTY tty_table[NR_CONSOLES];
 PUBLIC CONSOLE console_table[NR_CONSOLES];
+PUBLIC SERIAL serial_table[NR_SERIALS];
 
 PUBLIC irq_handler irq_table[NR_IRQ];
 
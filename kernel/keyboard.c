@@ -11,14 +11,25 @@
 #include "proc.h"
 #include "tty.h"
 #include "console.h"
+#include "serial.h"
 #include "global.h"
 #include "proto.h"
 #include "keyboard.h"
 #include "keymap.h"
+#include "kbtrace.h"
 
 PRIVATE KB_INPUT kb_in;
+PRIVATE KB_CMD_QUEUE kb_cmd;
+PRIVATE KB_REPEAT kb_repeat;
+PRIVATE KB_TRACE kb_trace;
+PRIVATE KB_REPLAY kb_replay;
+
+PRIVATE int kb_state;	 /* 扫描码解码器的状态 */
+PRIVATE int kb_seq_pos;	 /* Pause 序列中已经匹配的字节数 */
+PRIVATE u16 key_code;	 /* 最近解出的键的扫描码，E0 键再加上 0x100 */
+PRIVATE u8 pausebrk_scode[] = {0xE1, 0x1D, 0x45,
+							   0xE1, 0x9D, 0xC5};
 
-PRIVATE int code_with_E0;
 PRIVATE int shift_l;	 /* l shift state */
 PRIVATE int shift_r;	 /* r shift state */
 PRIVATE int alt_l;		 /* l alt state	 */
@@ -28,16 +39,30 @@ PRIVATE int ctrl_r;		 /* l ctrl state	 */
 PRIVATE int caps_lock;   /* Caps Lock	 */
 PRIVATE int num_lock;	/* Num Lock	 */
 PRIVATE int scroll_lock; /* Scroll Lock	 */
-PRIVATE int column;
+PRIVATE int key_layer;	 /* 当前使用 keymap 的哪一列 */
+PRIVATE u32 key_flags;	 /* 当前的 Shift/Ctrl/Alt 标志 */
 
 PRIVATE int caps_lock;   /* Caps Lock	 */
 PRIVATE int num_lock;	/* Num Lock	 */
 PRIVATE int scroll_lock; /* Scroll Lock	 */
 
-PRIVATE u8 get_byte_from_kbuf();
+PRIVATE int put_byte_to_kbuf(u8 scan_code);
+PRIVATE int get_byte_from_kbuf(u8 *p_scan_code);
+PRIVATE int decode_scan_code(u8 scan_code, u32 *p_key, int *p_make);
+PRIVATE int map_scan_code(u8 scan_code, int code_with_E0, u32 *p_key, int *p_make);
+PRIVATE u32 process_key(u32 key, int make);
+PRIVATE TTY *deliver_keys(TTY *p_tty, KEY_EVENT *events, int nr_events);
+PRIVATE void hold_key(u32 key, u16 code);
+PRIVATE void update_key_layer();
+PRIVATE void release_keys();
+PRIVATE void kb_replay_fill();
+PRIVATE void kb_replay_finish();
 PRIVATE void set_leds();
-PRIVATE void kb_wait();
-PRIVATE void kb_ack();
+PRIVATE int kb_cmd_queue(u8 *cmd, int len);
+PRIVATE void kb_cmd_poll();
+PRIVATE void kb_cmd_ack(u8 response);
+PRIVATE void kb_cmd_resend();
+PRIVATE void kb_cmd_send();
 
 /*======================================================================*
                             keyboard_handler
@@ -45,16 +70,26 @@ PRIVATE void kb_ack();
 PUBLIC void keyboard_handler(int irq)
 {
 	u8 scan_code = in_byte(KB_DATA);
+	KB_TRACE_ENTRY *p_entry;
 
-	if (kb_in.count < KB_IN_BYTES)
+	if (kb_trace.capturing)
 	{
-		*(kb_in.p_head) = scan_code;
-		kb_in.p_head++;
-		if (kb_in.p_head == kb_in.buf + KB_IN_BYTES)
-		{
-			kb_in.p_head = kb_in.buf;
-		}
-		kb_in.count++;
+		p_entry = &kb_trace.buf[kb_trace.head & KB_TRACE_MASK];
+		p_entry->tick = ticks;
+		p_entry->code = scan_code;
+		kb_trace.head++;
+	}
+
+	/* ACK/RESEND 是 8042 对命令的应答，不是扫描码 */
+	if (scan_code == KB_ACK || scan_code == KB_RESEND)
+	{
+		kb_cmd_ack(scan_code);
+		return;
+	}
+
+	if (!put_byte_to_kbuf(scan_code))
+	{
+		kb_in.overflow++;
 	}
 }
 
@@ -63,8 +98,22 @@ PUBLIC void keyboard_handler(int irq)
 *======================================================================*/
 PUBLIC void init_keyboard()
 {
-	kb_in.count = 0;
-	kb_in.p_head = kb_in.p_tail = kb_in.buf;
+	u8 typematic[2];
+	u32 flags;
+
+	/* head 只能由中断处理程序修改，这里只丢弃已有的字节 */
+	kb_in.tail = kb_in.head;
+	kb_in.overflow = 0;
+	kb_in.high_water = 0;
+	kb_state = KB_S_NORMAL;
+
+	/* 丢弃还没有发完的命令，之后到达的应答会被忽略。
+	 * kernel_main 在 restart 之前也会调用这里，不能把中断打开 */
+	flags = disable_int_save();
+	kb_cmd.tail = kb_cmd.head;
+	kb_cmd.busy = 0;
+	kb_cmd.retries = 0;
+	restore_int(flags);
 
 	shift_l = shift_r = 0;
 	alt_l = alt_r = 0;
@@ -74,8 +123,16 @@ PUBLIC void init_keyboard()
 	num_lock = 1;
 	scroll_lock = 0;
 
+	update_key_layer();
 	set_leds();
 
+	/* 按住的键由 kb_repeat_tick 来重复，让键盘自己的重复尽量慢一些 */
+	kb_repeat.armed = 0;
+	set_typematic(KB_REPEAT_DELAY, KB_REPEAT_RATE);
+	typematic[0] = KB_TYPEMATIC;
+	typematic[1] = KB_HW_TYPEMATIC;
+	kb_cmd_queue(typematic, 2);
+
 	put_irq_handler(KEYBOARD_IRQ, keyboard_handler); /*设定键盘中断处理程序*/
 	enable_irq(KEYBOARD_IRQ);						 /*开键盘中断*/
 }
@@ -86,290 +143,713 @@ PUBLIC void init_keyboard()
 PUBLIC void keyboard_read(TTY *p_tty)
 {
 	u8 scan_code;
-	char output[2];
+	u32 key;
 	int make; /* 1: make;  0: break. */
+	KEY_EVENT events[KB_BATCH_SIZE];
+	int nr_events = 0;
+	u32 repeats;
 
-	u32 key = 0; /* 用一个整型来表示一个键。比如，如果 Home 被按下，
-			 * 则 key 值将为定义在 keyboard.h 中的 'HOME'。
-			 */
-	u32 *keyrow; /* 指向 keymap[] 的某一行 */
+	if (kb_cmd.head != kb_cmd.tail)
+	{
+		kb_cmd_poll();
+	}
 
-	if (kb_in.count > 0)
+	if (kb_replay.active && kb_replay.mode == KB_REPLAY_FAST)
 	{
-		code_with_E0 = 0;
+		kb_replay_fill();
+	}
 
-		scan_code = get_byte_from_kbuf();
+	/* 按住的键在上次之后又重复了几次，合成一个带次数的事件 */
+	repeats = kb_repeat.issued - kb_repeat.consumed;
+	if (repeats)
+	{
+		kb_repeat.consumed += repeats;
+		if (kb_replay.active)
+		{
+			kb_replay.keys += repeats;
+		}
+		events[nr_events].key = kb_repeat.key;
+		events[nr_events].count = repeats;
+		nr_events++;
+	}
 
-		/* 下面开始解析扫描码 */
-		if (scan_code == 0xE1)
+	/* 一次取完缓冲区中所有的字节，解出的键攒成一批再交给 in_process。
+	 * 序列不完整时解码器保存状态直接返回，下次调用时从断点继续，
+	 * 键盘任务不会在这里空转等待。
+	 */
+	while (get_byte_from_kbuf(&scan_code))
+	{
+		if (decode_scan_code(scan_code, &key, &make))
 		{
-			int i;
-			u8 pausebrk_scode[] = {0xE1, 0x1D, 0x45,
-								   0xE1, 0x9D, 0xC5};
-			int is_pausebreak = 1;
-			for (i = 1; i < 6; i++)
+			key = process_key(key, make);
+			if (key)
 			{
-				if (get_byte_from_kbuf() != pausebrk_scode[i])
+				if (kb_replay.active)
 				{
-					is_pausebreak = 0;
-					break;
+					kb_replay.keys++;
 				}
+				events[nr_events].key = key;
+				events[nr_events].count = 1;
+				nr_events++;
 			}
-			if (is_pausebreak)
+			if (nr_events == KB_BATCH_SIZE)
 			{
-				key = PAUSEBREAK;
+				p_tty = deliver_keys(p_tty, events, nr_events);
+				nr_events = 0;
 			}
 		}
-		else if (scan_code == 0xE0)
+	}
+
+	if (nr_events)
+	{
+		deliver_keys(p_tty, events, nr_events);
+	}
+
+	/* 记录全部放完并且都已经处理掉了 */
+	if (kb_replay.active && kb_replay.pos == kb_replay.len &&
+		kb_in.head == kb_in.tail)
+	{
+		kb_replay_finish();
+	}
+}
+
+/*======================================================================*
+                           deliver_keys
+ *----------------------------------------------------------------------*
+ 把一批键交给 in_process_batch。如果其中某个键切换了控制台(Alt+Fn)，
+ 剩下的键交给新的当前控制台。返回之后的键应当交给的 TTY。
+ *======================================================================*/
+PRIVATE TTY *deliver_keys(TTY *p_tty, KEY_EVENT *events, int nr_events)
+{
+	int done;
+
+	while (nr_events > 0)
+	{
+		done = in_process_batch(p_tty, events, nr_events);
+		events += done;
+		nr_events -= done;
+		p_tty = &tty_table[nr_current_console];
+	}
+
+	return p_tty;
+}
+
+/*======================================================================*
+                           decode_scan_code
+ *----------------------------------------------------------------------*
+ 扫描码解码状态机，每次只吃进一个字节。
+ 返回 1 表示得到了一个完整的键（key 和 make 有效），返回 0 表示还需要
+ 更多的字节。
+ *======================================================================*/
+PRIVATE int decode_scan_code(u8 scan_code, u32 *p_key, int *p_make)
+{
+	switch (kb_state)
+	{
+	case KB_S_E1:
+		/* Pause 序列 E1 1D 45 E1 9D C5，不匹配时整个序列作废 */
+		if (scan_code != pausebrk_scode[kb_seq_pos])
+		{
+			kb_state = KB_S_NORMAL;
+			return 0;
+		}
+		if (++kb_seq_pos < (int)sizeof(pausebrk_scode))
+		{
+			return 0;
+		}
+		kb_state = KB_S_NORMAL;
+		key_code = 0;
+		*p_key = PAUSEBREAK;
+		*p_make = 1;
+		return 1;
+	case KB_S_E0:
+		/* PrintScreen 被按下: E0 2A E0 37 */
+		if (scan_code == 0x2A)
+		{
+			kb_state = KB_S_E0_2A;
+			return 0;
+		}
+		/* PrintScreen 被释放: E0 B7 E0 AA */
+		if (scan_code == 0xB7)
+		{
+			kb_state = KB_S_E0_B7;
+			return 0;
+		}
+		kb_state = KB_S_NORMAL;
+		return map_scan_code(scan_code, 1, p_key, p_make);
+	case KB_S_E0_2A:
+	case KB_S_E0_B7:
+		if (scan_code == 0xE0)
+		{
+			kb_state = (kb_state == KB_S_E0_2A) ? KB_S_E0_2A_E0 : KB_S_E0_B7_E0;
+			return 0;
+		}
+		/* 单独的 E0 2A / E0 B7，当作新的字节重新解析 */
+		kb_state = KB_S_NORMAL;
+		return decode_scan_code(scan_code, p_key, p_make);
+	case KB_S_E0_2A_E0:
+		kb_state = KB_S_NORMAL;
+		if (scan_code == 0x37)
 		{
-			scan_code = get_byte_from_kbuf();
+			key_code = 0;
+			*p_key = PRINTSCREEN;
+			*p_make = 1;
+			return 1;
+		}
+		/* E0 2A 是键盘加的假 Shift，后面跟的是一个普通的 E0 键 */
+		return map_scan_code(scan_code, 1, p_key, p_make);
+	case KB_S_E0_B7_E0:
+		kb_state = KB_S_NORMAL;
+		if (scan_code == 0xAA)
+		{
+			key_code = 0;
+			*p_key = PRINTSCREEN;
+			*p_make = 0;
+			return 1;
+		}
+		return map_scan_code(scan_code, 1, p_key, p_make);
+	default:
+		if (scan_code == 0xE1)
+		{
+			kb_state = KB_S_E1;
+			kb_seq_pos = 1;
+			return 0;
+		}
+		if (scan_code == 0xE0)
+		{
+			kb_state = KB_S_E0;
+			return 0;
+		}
+		return map_scan_code(scan_code, 0, p_key, p_make);
+	}
+}
 
-			/* PrintScreen 被按下 */
-			if (scan_code == 0x2A)
-			{
-				if (get_byte_from_kbuf() == 0xE0)
-				{
-					if (get_byte_from_kbuf() == 0x37)
-					{
-						key = PRINTSCREEN;
-						make = 1;
-					}
-				}
-			}
-			/* PrintScreen 被释放 */
-			if (scan_code == 0xB7)
-			{
-				if (get_byte_from_kbuf() == 0xE0)
-				{
-					if (get_byte_from_kbuf() == 0xAA)
-					{
-						key = PRINTSCREEN;
-						make = 0;
-					}
-				}
-			}
-			/* 不是PrintScreen, 此时scan_code为0xE0紧跟的那个值. */
-			if (key == 0)
+/*======================================================================*
+                           map_scan_code
+ *======================================================================*/
+PRIVATE int map_scan_code(u8 scan_code, int code_with_E0, u32 *p_key, int *p_make)
+{
+	u8 row = scan_code & 0x7F;
+
+	key_code = code_with_E0 ? (0x100 | row) : row;
+
+	/* 首先判断Make Code 还是 Break Code */
+	*p_make = (scan_code & FLAG_BREAK ? 0 : 1);
+
+	/* 当前的 Shift/Lock 状态已经决定了用哪一列，查一次表即可 */
+	*p_key = row < NR_KEYMAP_ROWS ?
+				 keymap[row * MAP_COLS + (code_with_E0 ? KL_E0 : key_layer)] :
+				 0;
+
+	return 1;
+}
+
+/*======================================================================*
+                           process_key
+ *======================================================================*/
+PRIVATE u32 process_key(u32 key, int make) /* 返回应交给 tty 的键，0 表示没有 */
+{
+	switch (key)
+	{
+	case SHIFT_L:
+		shift_l = make;
+		break;
+	case SHIFT_R:
+		shift_r = make;
+		break;
+	case CTRL_L:
+		ctrl_l = make;
+		break;
+	case CTRL_R:
+		ctrl_r = make;
+		break;
+	case ALT_L:
+		alt_l = make;
+		break;
+	case ALT_R:
+		alt_r = make;
+		break;
+	case CAPS_LOCK:
+		if (!make)
+		{
+			return 0;
+		}
+		caps_lock = !caps_lock;
+		set_leds();
+		break;
+	case NUM_LOCK:
+		if (!make)
+		{
+			return 0;
+		}
+		num_lock = !num_lock;
+		set_leds();
+		break;
+	case SCROLL_LOCK:
+		if (!make)
+		{
+			return 0;
+		}
+		scroll_lock = !scroll_lock;
+		set_leds();
+		break;
+	default:
+		if (!key)
+		{
+			return 0;
+		}
+		/* 忽略 Break Code，但松开的如果是正在重复的键就停止重复 */
+		if (!make)
+		{
+			if (kb_repeat.armed && key_code == kb_repeat.code)
 			{
-				code_with_E0 = 1;
+				kb_repeat.armed = 0;
 			}
+			return 0;
+		}
+		/* 键盘自己发出的重复，已经由 kb_repeat_tick 处理了 */
+		if (kb_repeat.armed && key_code == kb_repeat.code)
+		{
+			return 0;
 		}
-		if ((key != PAUSEBREAK) && (key != PRINTSCREEN))
+		key |= key_flags;
+		if (key_code)
 		{
-			/* 首先判断Make Code 还是 Break Code */
-			make = (scan_code & FLAG_BREAK ? 0 : 1);
+			hold_key(key, key_code);
+		}
+		return key;
+	}
 
-			/* 先定位到 keymap 中的行 */
-			keyrow = &keymap[(scan_code & 0x7F) * MAP_COLS];
+	update_key_layer();
 
-			column = 0;
+	return make ? (key | key_flags) : 0;
+}
 
-			int caps = shift_l || shift_r;
-			if (caps_lock)
-			{
-				if ((keyrow[0] >= 'a') && (keyrow[0] <= 'z'))
-				{
-					caps = !caps;
-				}
-			}
-			if (caps)
-			{
-				column = 1;
-			}
+/*======================================================================*
+                           update_key_layer
+ *----------------------------------------------------------------------*
+ Shift/Ctrl/Alt/Lock 的状态变化时重新计算 key_layer 和 key_flags。
+ *======================================================================*/
+PRIVATE void update_key_layer()
+{
+	if (shift_l || shift_r)
+	{
+		key_layer = caps_lock ? KL_CAPS_SHIFT : KL_SHIFT;
+	}
+	else
+	{
+		key_layer = (caps_lock ? KL_CAPS : KL_BASE) + (num_lock ? 1 : 0);
+	}
 
-			if (code_with_E0)
-			{
-				column = 2;
-			}
+	key_flags = 0;
+	key_flags |= shift_l ? FLAG_SHIFT_L : 0;
+	key_flags |= shift_r ? FLAG_SHIFT_R : 0;
+	key_flags |= ctrl_l ? FLAG_CTRL_L : 0;
+	key_flags |= ctrl_r ? FLAG_CTRL_R : 0;
+	key_flags |= alt_l ? FLAG_ALT_L : 0;
+	key_flags |= alt_r ? FLAG_ALT_R : 0;
+}
 
-			key = keyrow[column];
+/*======================================================================*
+                           release_keys
+ *----------------------------------------------------------------------*
+ 当作所有的键都已松开：清掉 Shift/Ctrl/Alt、停止自动重复，并丢弃
+ 解到一半的序列。锁定键的状态不变。
+ *======================================================================*/
+PRIVATE void release_keys()
+{
+	shift_l = shift_r = 0;
+	alt_l = alt_r = 0;
+	ctrl_l = ctrl_r = 0;
+	kb_state = KB_S_NORMAL;
+	kb_repeat.armed = 0;
 
-			switch (key)
-			{
-			case SHIFT_L:
-				shift_l = make;
-				break;
-			case SHIFT_R:
-				shift_r = make;
-				break;
-			case CTRL_L:
-				ctrl_l = make;
-				break;
-			case CTRL_R:
-				ctrl_r = make;
-				break;
-			case ALT_L:
-				alt_l = make;
-				break;
-			case ALT_R:
-				alt_l = make;
-				break;
-			case CAPS_LOCK:
-				if (make)
-				{
-					caps_lock = !caps_lock;
-					set_leds();
-				}
-				break;
-			case NUM_LOCK:
-				if (make)
-				{
-					num_lock = !num_lock;
-					set_leds();
-				}
-				break;
-			case SCROLL_LOCK:
-				if (make)
-				{
-					scroll_lock = !scroll_lock;
-					set_leds();
-				}
-				break;
-			default:
-				break;
-			}
+	update_key_layer();
+}
 
-			if (make)
-			{ /* 忽略 Break Code */
-				int pad = 0;
+/*======================================================================*
+                           hold_key
+ *----------------------------------------------------------------------*
+ 记下被按住的键，KB_REPEAT_DELAY 之后由 kb_repeat_tick 开始重复。
+ *======================================================================*/
+PRIVATE void hold_key(u32 key, u16 code)
+{
+	/* armed 为 0 时 kb_repeat_tick 不会碰其它成员 */
+	kb_repeat.armed = 0;
+	if (kb_repeat.period == 0)
+	{
+		return;
+	}
+	kb_repeat.key = key;
+	kb_repeat.code = code;
+	kb_repeat.consumed = kb_repeat.issued;
+	kb_repeat.next = ticks + kb_repeat.delay;
+	kb_repeat.armed = 1;
+}
 
-				/* 首先处理小键盘 */
-				if ((key >= PAD_SLASH) && (key <= PAD_9))
-				{
-					pad = 1;
-					switch (key)
-					{
-					case PAD_SLASH:
-						key = '/';
-						break;
-					case PAD_STAR:
-						key = '*';
-						break;
-					case PAD_MINUS:
-						key = '-';
-						break;
-					case PAD_PLUS:
-						key = '+';
-						break;
-					case PAD_ENTER:
-						key = ENTER;
-						break;
-					default:
-						if (num_lock &&
-							(key >= PAD_0) &&
-							(key <= PAD_9))
-						{
-							key = key - PAD_0 + '0';
-						}
-						else if (num_lock &&
-								 (key == PAD_DOT))
-						{
-							key = '.';
-						}
-						else
-						{
-							switch (key)
-							{
-							case PAD_HOME:
-								key = HOME;
-								break;
-							case PAD_END:
-								key = END;
-								break;
-							case PAD_PAGEUP:
-								key = PAGEUP;
-								break;
-							case PAD_PAGEDOWN:
-								key = PAGEDOWN;
-								break;
-							case PAD_INS:
-								key = INSERT;
-								break;
-							case PAD_UP:
-								key = UP;
-								break;
-							case PAD_DOWN:
-								key = DOWN;
-								break;
-							case PAD_LEFT:
-								key = LEFT;
-								break;
-							case PAD_RIGHT:
-								key = RIGHT;
-								break;
-							case PAD_DOT:
-								key = DELETE;
-								break;
-							default:
-								break;
-							}
-						}
-						break;
-					}
-				}
+/*======================================================================*
+                           kb_repeat_tick
+ *----------------------------------------------------------------------*
+ 由 clock_handler 每个 tick 调用一次。
+ *======================================================================*/
+PUBLIC void kb_repeat_tick()
+{
+	if (kb_repeat.armed && ticks - kb_repeat.next >= 0)
+	{
+		kb_repeat.issued++;
+		kb_repeat.next += kb_repeat.period;
+	}
+}
 
-				key |= shift_l ? FLAG_SHIFT_L : 0;
-				key |= shift_r ? FLAG_SHIFT_R : 0;
-				key |= ctrl_l ? FLAG_CTRL_L : 0;
-				key |= ctrl_r ? FLAG_CTRL_R : 0;
-				key |= alt_l ? FLAG_ALT_L : 0;
-				key |= alt_r ? FLAG_ALT_R : 0;
-				key |= pad ? FLAG_PAD : 0;
+/*======================================================================*
+                           set_typematic
+ *----------------------------------------------------------------------*
+ delay: 按住多少毫秒之后开始重复
+ rate : 每秒重复多少次，0 表示不重复
+ *======================================================================*/
+PUBLIC void set_typematic(int delay, int rate)
+{
+	kb_repeat.armed = 0;
 
-				in_process(p_tty, key);
-			}
+	kb_repeat.delay = delay * HZ / 1000;
+	if (kb_repeat.delay < 1)
+	{
+		kb_repeat.delay = 1;
+	}
+
+	if (rate <= 0)
+	{
+		kb_repeat.period = 0;
+	}
+	else
+	{
+		kb_repeat.period = HZ / rate;
+		if (kb_repeat.period < 1)
+		{
+			kb_repeat.period = 1;
 		}
 	}
 }
 
+/*======================================================================*
+			    put_byte_to_kbuf
+ *----------------------------------------------------------------------*
+ 只能由当前唯一的生产者调用：平时是 keyboard_handler，回放时是回放代码。
+ 缓冲区满时返回 0。
+ *======================================================================*/
+PRIVATE int put_byte_to_kbuf(u8 scan_code)
+{
+	u32 used = kb_in.head - kb_in.tail;
+
+	if (used >= KB_IN_BYTES)
+	{
+		return 0;
+	}
+
+	kb_in.buf[kb_in.head & KB_IN_MASK] = scan_code;
+	/* 先写数据再移动 head，键盘任务看到新的 head 时数据一定已经就绪 */
+	kb_in.head++;
+	if (used + 1 > kb_in.high_water)
+	{
+		kb_in.high_water = used + 1;
+	}
+
+	return 1;
+}
+
 /*======================================================================*
 			    get_byte_from_kbuf
  *======================================================================*/
-PRIVATE u8 get_byte_from_kbuf() /* 从键盘缓冲区中读取下一个字节 */
+PRIVATE int get_byte_from_kbuf(u8 *p_scan_code) /* 从键盘缓冲区中读取下一个字节 */
 {
-	u8 scan_code;
+	/* 缓冲区为空时立即返回，不再等待下一个字节到来 */
+	if (kb_in.head == kb_in.tail)
+	{
+		return 0;
+	}
+
+	/* tail 只由键盘任务修改，不需要关中断 */
+	*p_scan_code = kb_in.buf[kb_in.tail & KB_IN_MASK];
+	kb_in.tail++;
+
+	return 1;
+}
+
+/*======================================================================*
+			    get_kb_stat
+ *======================================================================*/
+PUBLIC void get_kb_stat(u32 *p_overflow, u32 *p_high_water)
+{
+	*p_overflow = kb_in.overflow;
+	*p_high_water = kb_in.high_water;
+}
+
+/*======================================================================*
+			    kb_toggle_capture
+ *----------------------------------------------------------------------*
+ 开始/停止录制 keyboard_handler 收到的每个字节(包括 8042 的应答)。
+ 开始时丢弃以前录下的内容。
+ *======================================================================*/
+PUBLIC void kb_toggle_capture()
+{
+	if (kb_trace.capturing)
+	{
+		kb_trace.capturing = 0;
+	}
+	else
+	{
+		kb_trace.head = 0;
+		kb_trace.capturing = 1;
+	}
+}
+
+/*======================================================================*
+			    kb_trace_dump
+ *----------------------------------------------------------------------*
+ 停止录制，把录下的字节按 kbtrace.h 的格式写到 p_tty。
+ *======================================================================*/
+PUBLIC void kb_trace_dump(TTY *p_tty)
+{
+	char line[32];
+	KB_TRACE_ENTRY *p_entry;
+	u32 head;
+	u32 i;
+	int n = 0;
+
+	kb_trace.capturing = 0;
+	head = kb_trace.head;
+	i = (head > KB_TRACE_BYTES) ? head - KB_TRACE_BYTES : 0;
+
+	sprintf(line, "\ntrace: %d bytes\n", head - i);
+	tty_write(p_tty, line, strlen(line));
+
+	for (; i < head; i++)
+	{
+		p_entry = &kb_trace.buf[i & KB_TRACE_MASK];
+		sprintf(line, (++n % 6) ? "{%d, %x}, " : "{%d, %x},\n",
+			p_entry->tick, p_entry->code);
+		tty_write(p_tty, line, strlen(line));
+	}
+	tty_write(p_tty, "\n", 1);
+}
+
+/*======================================================================*
+			    kb_start_replay
+ *----------------------------------------------------------------------*
+ 回放 kbtrace.h 中的记录。回放期间键盘中断是关着的。
+ mode: KB_REPLAY_TIMED 按录制时的时间间隔回放
+       KB_REPLAY_FAST  键盘任务能处理多快就回放多快
+ *======================================================================*/
+PUBLIC void kb_start_replay(int mode)
+{
+	if (kb_replay.active)
+	{
+		return;
+	}
+
+	disable_irq(KEYBOARD_IRQ);
+	/* 触发回放的 Ctrl 还没有松开，它的 Break Code 要等回放结束才能收到 */
+	release_keys();
+
+	kb_replay.trace = kb_replay_trace;
+	kb_replay.len = sizeof(kb_replay_trace) / sizeof(kb_replay_trace[0]);
+	kb_replay.pos = 0;
+	kb_replay.mode = mode;
+	kb_replay.keys = 0;
+	kb_replay.done = 0;
+	kb_replay.start = ticks;
+	/* 最后才置 active，kb_replay_tick 看到它时其余字段都已就绪 */
+	kb_replay.active = 1;
+}
 
-	while (kb_in.count <= 0)
+/*======================================================================*
+			    kb_replay_tick
+ *----------------------------------------------------------------------*
+ 由 clock_handler 每个 tick 调用一次，定时回放时把到时间的记录放进
+ kb_in。放不下的留到下一个 tick。
+ *======================================================================*/
+PUBLIC void kb_replay_tick()
+{
+	int elapsed;
+
+	if (!kb_replay.active || kb_replay.mode != KB_REPLAY_TIMED)
 	{
-	} /* 等待下一个字节到来 */
+		return;
+	}
+
+	elapsed = ticks - kb_replay.start;
+	while (kb_replay.pos < kb_replay.len &&
+		   kb_replay.trace[kb_replay.pos].tick - kb_replay.trace[0].tick <= elapsed &&
+		   put_byte_to_kbuf(kb_replay.trace[kb_replay.pos].code))
+	{
+		kb_replay.pos++;
+	}
+}
+
+/*======================================================================*
+			    kb_replay_fill
+ *----------------------------------------------------------------------*
+ 全速回放：把 kb_in 填满。
+ *======================================================================*/
+PRIVATE void kb_replay_fill()
+{
+	while (kb_replay.pos < kb_replay.len &&
+		   put_byte_to_kbuf(kb_replay.trace[kb_replay.pos].code))
+	{
+		kb_replay.pos++;
+	}
+}
+
+/*======================================================================*
+			    kb_replay_finish
+ *======================================================================*/
+PRIVATE void kb_replay_finish()
+{
+	kb_replay.active = 0;
+	release_keys();
+	enable_irq(KEYBOARD_IRQ);
+	kb_replay.done = 1;
+}
 
-	disable_int();
-	scan_code = *(kb_in.p_tail);
-	kb_in.p_tail++;
-	if (kb_in.p_tail == kb_in.buf + KB_IN_BYTES)
+/*======================================================================*
+			    kb_replay_poll
+ *----------------------------------------------------------------------*
+ 回放结束后第一次调用时返回 1，并给出回放产生的键数和所用的 ticks。
+ 应当在回放产生的输出都已经写到屏幕之后再调用。
+ *======================================================================*/
+PUBLIC int kb_replay_poll(u32 *p_keys, int *p_ticks)
+{
+	if (!kb_replay.done)
 	{
-		kb_in.p_tail = kb_in.buf;
+		return 0;
 	}
-	kb_in.count--;
-	enable_int();
 
-	return scan_code;
+	kb_replay.done = 0;
+	*p_keys = kb_replay.keys;
+	*p_ticks = ticks - kb_replay.start;
+
+	return 1;
 }
 
 /*======================================================================*
-				 kb_wait
+				 kb_cmd_queue
+ *----------------------------------------------------------------------*
+ 把要发给 8042 的字节放进命令队列，然后立即返回。
+ 每个字节发出后要等键盘回 ACK(0xFA) 才发下一个，这一步在
+ keyboard_handler 中完成；收到 RESEND(0xFE) 则重发当前字节。
+ 返回 0 表示队列已满，命令被丢弃。
  *======================================================================*/
-PRIVATE void kb_wait() /* 等待 8042 的输入缓冲区空 */
+PRIVATE int kb_cmd_queue(u8 *cmd, int len)
 {
-	u8 kb_stat;
+	int i;
 
-	do
+	if (kb_cmd.head - kb_cmd.tail + len > KB_CMD_BYTES)
 	{
-		kb_stat = in_byte(KB_CMD);
-	} while (kb_stat & 0x02);
+		return 0;
+	}
+
+	for (i = 0; i < len; i++)
+	{
+		kb_cmd.buf[(kb_cmd.head + i) & KB_CMD_MASK] = cmd[i];
+	}
+	/* head 只由键盘任务修改 */
+	kb_cmd.head += len;
+
+	kb_cmd_poll();
+
+	return 1;
 }
 
 /*======================================================================*
-				 kb_ack
+				 kb_cmd_poll
+ *----------------------------------------------------------------------*
+ 由键盘任务调用：队列空闲时发出下一个字节，或者在等待应答超时后重发。
  *======================================================================*/
-PRIVATE void kb_ack()
+PRIVATE void kb_cmd_poll()
 {
-	u8 kb_read;
+	u32 flags;
 
-	do
+	/* 与 keyboard_handler 竞争 busy/tail，关中断；只有 LED 等命令才会走到这里。
+	 * init_keyboard 也会走到这里，所以恢复原来的 IF 而不是直接开中断 */
+	flags = disable_int_save();
+	if (kb_cmd.head != kb_cmd.tail)
 	{
-		kb_read = in_byte(KB_DATA);
-	} while (kb_read = !KB_ACK);
+		if (!kb_cmd.busy)
+		{
+			kb_cmd_send();
+		}
+		else if (ticks - kb_cmd.sent_at > KB_CMD_TIMEOUT)
+		{
+			/* 没有收到应答，按 RESEND 处理 */
+			kb_cmd_resend();
+		}
+	}
+	restore_int(flags);
+}
+
+/*======================================================================*
+				 kb_cmd_ack
+ *----------------------------------------------------------------------*
+ 在 keyboard_handler 中调用，处理 8042 回应的 ACK/RESEND。
+ *======================================================================*/
+PRIVATE void kb_cmd_ack(u8 response)
+{
+	if (!kb_cmd.busy)
+	{
+		return; /* 不是在等应答(比如超时后才到的 ACK)，丢掉 */
+	}
+
+	if (response == KB_ACK)
+	{
+		/* tail 只由 keyboard_handler 和关了中断的 kb_cmd_poll 修改 */
+		kb_cmd.tail++;
+		kb_cmd.busy = 0;
+		kb_cmd.retries = 0;
+		if (kb_cmd.head != kb_cmd.tail)
+		{
+			kb_cmd_send();
+		}
+	}
+	else
+	{
+		kb_cmd_resend();
+	}
+}
+
+/*======================================================================*
+				 kb_cmd_resend
+ *======================================================================*/
+PRIVATE void kb_cmd_resend()
+{
+	kb_cmd.busy = 0;
+	if (++kb_cmd.retries > KB_CMD_RETRIES)
+	{
+		/* 重试太多次，放弃这个字节 */
+		kb_cmd.tail++;
+		kb_cmd.retries = 0;
+		kb_cmd.dropped++;
+	}
+	if (kb_cmd.head != kb_cmd.tail)
+	{
+		kb_cmd_send();
+	}
+}
+
+/*======================================================================*
+				 kb_cmd_send
+ *----------------------------------------------------------------------*
+ 发出队列中的当前字节。8042 的输入缓冲区还满着时不等待，
+ 留给之后的 kb_cmd_poll 再试。
+ *======================================================================*/
+PRIVATE void kb_cmd_send()
+{
+	if (in_byte(KB_CMD) & KB_STAT_IBF)
+	{
+		return;
+	}
+
+	out_byte(KB_DATA, kb_cmd.buf[kb_cmd.tail & KB_CMD_MASK]);
+	kb_cmd.busy = 1;
+	kb_cmd.sent_at = ticks;
 }
 
 /*======================================================================*
@@ -377,13 +857,10 @@ PRIVATE void kb_ack()
  *======================================================================*/
 PRIVATE void set_leds()
 {
-	u8 leds = (caps_lock << 2) | (num_lock << 1) | scroll_lock;
+	u8 cmd[2];
 
-	kb_wait();
-	out_byte(KB_DATA, LED_CODE);
-	kb_ack();
+	cmd[0] = LED_CODE;
+	cmd[1] = (caps_lock << 2) | (num_lock << 1) | scroll_lock;
 
-	kb_wait();
-	out_byte(KB_DATA, leds);
-	kb_ack();
+	kb_cmd_queue(cmd, 2);
 }
@@ -10,6 +10,7 @@
 #include "protect.h"
 #include "tty.h"
 #include "console.h"
+#include "serial.h"
 #include "string.h"
 #include "proc.h"
 #include "global.h"
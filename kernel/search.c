@@ -0,0 +1,355 @@
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                              search.c
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                                                    Forrest Yu, 2005
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+/*
+	搜索模式用的子串搜索。
+	search_mark 找出模式串的所有出现(包括相互重叠的)并标记出来，
+	具体用哪种算法由 engine 参数决定，SEARCH_AUTO 按模式串长度选择。
+*/
+
+#include "type.h"
+#include "const.h"
+#include "string.h"
+#include "search.h"
+
+PRIVATE int search_scan(const char *text, int len, const char *pat, int pat_len, u8 *marks);
+PRIVATE int search_horspool(const char *text, int len, const char *pat, int pat_len, u8 *marks);
+PRIVATE int search_two_way(const char *text, int len, const char *pat, int pat_len, u8 *marks);
+PRIVATE int scan_byte(const char *text, int from, int len, char ch);
+PRIVATE int match_at(const char *text, const char *pat, int pat_len);
+PRIVATE int max_suffix(const u8 *pat, int pat_len, int *p_period, int reverse);
+
+PRIVATE search_engine search_engines[NR_SEARCH_ENGINES] = {
+	0,			/* SEARCH_AUTO */
+	search_scan,		/* SEARCH_SCAN */
+	search_horspool,	/* SEARCH_HORSPOOL */
+	search_two_way		/* SEARCH_TWO_WAY */
+};
+
+/* 已经标记到哪里。相互重叠的匹配只标记新增的部分，标记的总开销是线性的 */
+PRIVATE int marked_end;
+
+/*======================================================================*
+                              search_mark
+ *----------------------------------------------------------------------*
+ 在 text[0..len) 中找出 pat[0..pat_len) 的所有出现，把每次出现覆盖的字符
+ 在 marks 中置为 1，其余置为 0。返回出现的次数。
+ *======================================================================*/
+PUBLIC int search_mark(const char *text, int len, const char *pat, int pat_len,
+		       u8 *marks, int engine)
+{
+	memset(marks, 0, len);
+	if (pat_len <= 0 || pat_len > len)
+	{
+		return 0;
+	}
+
+	if (engine <= SEARCH_AUTO || engine >= NR_SEARCH_ENGINES)
+	{
+		if (pat_len < SEARCH_SCAN_MAX)
+		{
+			engine = SEARCH_SCAN;
+		}
+		else if (pat_len <= SEARCH_HORSPOOL_MAX)
+		{
+			engine = SEARCH_HORSPOOL;
+		}
+		else
+		{
+			engine = SEARCH_TWO_WAY;
+		}
+	}
+
+	marked_end = 0;
+	return search_engines[engine](text, len, pat, pat_len, marks);
+}
+
+/*======================================================================*
+                              mark_match
+ *======================================================================*/
+PRIVATE void mark_match(u8 *marks, int pos, int pat_len)
+{
+	int from = (pos > marked_end) ? pos : marked_end;
+
+	memset(marks + from, 1, pos + pat_len - from);
+	marked_end = pos + pat_len;
+}
+
+/*======================================================================*
+                              search_scan
+ *----------------------------------------------------------------------*
+ 用 scan_byte 跳到下一个首字符，再比较剩下的字符。适合很短的模式串。
+ *======================================================================*/
+PRIVATE int search_scan(const char *text, int len, const char *pat, int pat_len, u8 *marks)
+{
+	int last = len - pat_len;
+	int nr = 0;
+	int i = 0;
+
+	while ((i = scan_byte(text, i, last + 1, pat[0])) <= last)
+	{
+		if (match_at(text + i + 1, pat + 1, pat_len - 1))
+		{
+			mark_match(marks, i, pat_len);
+			nr++;
+		}
+		i++;
+	}
+
+	return nr;
+}
+
+/*======================================================================*
+                              search_horspool
+ *----------------------------------------------------------------------*
+ Boyer-Moore-Horspool：用窗口最后一个字符查表决定右移多少。
+ 移动距离只由模式串本身决定，匹配成功后照常移动不会漏掉重叠的出现。
+ *======================================================================*/
+PRIVATE int search_horspool(const char *text, int len, const char *pat, int pat_len, u8 *marks)
+{
+	int skip[256];
+	const u8 *t = (const u8 *)text;
+	const u8 *p = (const u8 *)pat;
+	u8 tail = p[pat_len - 1];
+	int last = len - pat_len;
+	int nr = 0;
+	int i;
+
+	for (i = 0; i < 256; i++)
+	{
+		skip[i] = pat_len;
+	}
+	for (i = 0; i < pat_len - 1; i++)
+	{
+		skip[p[i]] = pat_len - 1 - i;
+	}
+
+	i = 0;
+	while (i <= last)
+	{
+		u8 ch = t[i + pat_len - 1];
+
+		if (ch == tail && match_at(text + i, pat, pat_len - 1))
+		{
+			mark_match(marks, i, pat_len);
+			nr++;
+		}
+		i += skip[ch];
+	}
+
+	return nr;
+}
+
+/*======================================================================*
+                              search_two_way
+ *----------------------------------------------------------------------*
+ Crochemore-Perrin Two-Way，常数空间，最坏情况线性。
+ 模式串在临界分解点 ell 处分成左右两半：先从左往右比较右半，失配时按
+ 已匹配的长度右移；右半匹配后再从右往左比较左半，成功后右移一个周期。
+ 模式串是周期的(左半是右半的后缀)时用 memory 记住已知匹配的前缀，
+ 保证每个字符最多比较常数次。
+ *======================================================================*/
+PRIVATE int search_two_way(const char *text, int len, const char *pat, int pat_len, u8 *marks)
+{
+	const u8 *t = (const u8 *)text;
+	const u8 *p = (const u8 *)pat;
+	int last = len - pat_len;
+	int nr = 0;
+	int ell;
+	int period;
+	int period_r;
+	int memory;
+	int i;
+	int j;
+
+	i = max_suffix(p, pat_len, &period, 0);
+	j = max_suffix(p, pat_len, &period_r, 1);
+	if (i <= j)
+	{
+		i = j;
+		period = period_r;
+	}
+	ell = i;
+
+	if (ell + 1 + period <= pat_len &&
+		match_at(pat, pat + period, ell + 1))
+	{
+		/* 周期的模式串 */
+		memory = -1;
+		j = 0;
+		while (j <= last)
+		{
+			i = ((ell > memory) ? ell : memory) + 1;
+			while (i < pat_len && p[i] == t[i + j])
+			{
+				i++;
+			}
+			if (i >= pat_len)
+			{
+				i = ell;
+				while (i > memory && p[i] == t[i + j])
+				{
+					i--;
+				}
+				if (i <= memory)
+				{
+					mark_match(marks, j, pat_len);
+					nr++;
+				}
+				j += period;
+				memory = pat_len - period - 1;
+			}
+			else
+			{
+				j += i - ell;
+				memory = -1;
+			}
+		}
+	}
+	else
+	{
+		period = ((ell + 1 > pat_len - ell - 1) ? ell + 1 : pat_len - ell - 1) + 1;
+		j = 0;
+		while (j <= last)
+		{
+			i = ell + 1;
+			while (i < pat_len && p[i] == t[i + j])
+			{
+				i++;
+			}
+			if (i >= pat_len)
+			{
+				i = ell;
+				while (i >= 0 && p[i] == t[i + j])
+				{
+					i--;
+				}
+				if (i < 0)
+				{
+					mark_match(marks, j, pat_len);
+					nr++;
+				}
+				j += period;
+			}
+			else
+			{
+				j += i - ell;
+			}
+		}
+	}
+
+	return nr;
+}
+
+/*======================================================================*
+                              max_suffix
+ *----------------------------------------------------------------------*
+ 求模式串的最大后缀(reverse 为 1 时按相反的字符顺序)，返回它开始位置
+ 的前一个下标，*p_period 是这个后缀的周期。
+ *======================================================================*/
+PRIVATE int max_suffix(const u8 *pat, int pat_len, int *p_period, int reverse)
+{
+	int ms = -1;
+	int j = 0;
+	int k = 1;
+	int period = 1;
+
+	while (j + k < pat_len)
+	{
+		u8 a = pat[j + k];
+		u8 b = pat[ms + k];
+
+		if (a == b)
+		{
+			if (k != period)
+			{
+				k++;
+			}
+			else
+			{
+				j += period;
+				k = 1;
+			}
+		}
+		else if ((a < b) != reverse)
+		{
+			j += k;
+			k = 1;
+			period = j - ms;
+		}
+		else
+		{
+			ms = j;
+			j = ms + 1;
+			k = period = 1;
+		}
+	}
+
+	*p_period = period;
+	return ms;
+}
+
+/*======================================================================*
+                              scan_byte
+ *----------------------------------------------------------------------*
+ 返回 text[from..len) 中第一个 ch 的下标，没有则返回 len。
+ 对齐之后每次读一个 32 位字，用 (w - 0x01010101) & ~w & 0x80808080
+ 判断字中是否有等于 ch 的字节，只在有的时候才逐个字节地找。
+ *======================================================================*/
+PRIVATE int scan_byte(const char *text, int from, int len, char ch)
+{
+	u32 pattern = (u8)ch * 0x01010101;
+	int i = from;
+
+	while (i < len && ((u32)(text + i) & 3))
+	{
+		if (text[i] == ch)
+		{
+			return i;
+		}
+		i++;
+	}
+
+	while (i + 4 <= len)
+	{
+		u32 w = *(const u32 *)(text + i) ^ pattern;
+
+		if ((w - 0x01010101) & ~w & 0x80808080)
+		{
+			break;
+		}
+		i += 4;
+	}
+
+	while (i < len)
+	{
+		if (text[i] == ch)
+		{
+			return i;
+		}
+		i++;
+	}
+
+	return len;
+}
+
+/*======================================================================*
+                              match_at
+ *======================================================================*/
+PRIVATE int match_at(const char *text, const char *pat, int pat_len)
+{
+	int i;
+
+	for (i = 0; i < pat_len; i++)
+	{
+		if (text[i] != pat[i])
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
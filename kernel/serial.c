@@ -0,0 +1,271 @@
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                              serial.c
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                                                    Forrest Yu, 2005
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+/*
+	COM1 (16550 UART) 驱动。
+	可以挂到任意一个 TTY 上：收到的字节翻译成键值交给 in_process，
+	TTY 回显和 tty_write 输出的字符同时从串口发出去。
+*/
+
+#include "type.h"
+#include "const.h"
+#include "protect.h"
+#include "string.h"
+#include "proc.h"
+#include "tty.h"
+#include "console.h"
+#include "serial.h"
+#include "global.h"
+#include "keyboard.h"
+#include "proto.h"
+
+PRIVATE void serial_tx_fill(SERIAL *p_serial);
+PRIVATE void serial_tx_put(SERIAL *p_serial, char ch);
+PRIVATE u32 serial_byte_to_key(u8 ch);
+
+/*======================================================================*
+                           init_serial
+ *======================================================================*/
+PUBLIC void init_serial()
+{
+	SERIAL *p_serial = serial_table;
+	u16 port = COM1_PORT;
+	int divisor = UART_CLOCK / SERIAL_BAUD;
+
+	p_serial->port = port;
+	p_serial->rx_head = p_serial->rx_tail = 0;
+	p_serial->tx_head = p_serial->tx_tail = 0;
+	p_serial->tx_busy = 0;
+	p_serial->rx_overflow = p_serial->tx_overflow = 0;
+
+	/* 用 scratch 寄存器检测 UART 是否存在 */
+	out_byte(port + UART_SCR, 0x5A);
+	p_serial->present = (in_byte(port + UART_SCR) == 0x5A);
+	if (!p_serial->present)
+	{
+		return;
+	}
+
+	out_byte(port + UART_IER, 0);
+	out_byte(port + UART_LCR, LCR_DLAB);
+	out_byte(port + UART_DLL, divisor & 0xFF);
+	out_byte(port + UART_DLM, (divisor >> 8) & 0xFF);
+	out_byte(port + UART_LCR, LCR_8N1);
+	out_byte(port + UART_FCR, FCR_ENABLE);
+	out_byte(port + UART_MCR, MCR_DTR_RTS_OUT2);
+
+	/* 清掉可能残留的状态 */
+	in_byte(port + UART_LSR);
+	in_byte(port + UART_RBR);
+	in_byte(port + UART_IIR);
+	in_byte(port + UART_MSR);
+
+	out_byte(port + UART_IER, IER_RDA | IER_THRE | IER_RLS);
+
+	put_irq_handler(RS232_IRQ, serial_handler); /* 设定串口中断处理程序 */
+	enable_irq(RS232_IRQ);			    /* 开串口中断 */
+}
+
+/*======================================================================*
+                           attach_serial
+ *----------------------------------------------------------------------*
+ 把串口挂到 TTY 上，作为另一个输入来源和输出的镜像。
+ *======================================================================*/
+PUBLIC void attach_serial(TTY *p_tty, int nr_serial)
+{
+	SERIAL *p_serial = &serial_table[nr_serial];
+
+	p_tty->p_serial = p_serial->present ? p_serial : 0;
+}
+
+/*======================================================================*
+                           serial_handler
+ *======================================================================*/
+PUBLIC void serial_handler(int irq)
+{
+	SERIAL *p_serial = serial_table;
+	u16 port = p_serial->port;
+	u8 iir;
+	u8 ch;
+
+	while (!((iir = in_byte(port + UART_IIR)) & IIR_NO_INT))
+	{
+		switch (iir & IIR_ID_MASK)
+		{
+		case IIR_RDA:
+		case IIR_TIMEOUT:
+			/* 一次取空接收 FIFO */
+			while (in_byte(port + UART_LSR) & LSR_DR)
+			{
+				ch = in_byte(port + UART_RBR);
+				if (p_serial->rx_head - p_serial->rx_tail < SERIAL_RX_BYTES)
+				{
+					p_serial->rx_buf[p_serial->rx_head & (SERIAL_RX_BYTES - 1)] = ch;
+					p_serial->rx_head++;
+				}
+				else
+				{
+					p_serial->rx_overflow++;
+				}
+			}
+			break;
+		case IIR_THRE:
+			serial_tx_fill(p_serial);
+			break;
+		case IIR_RLS:
+			in_byte(port + UART_LSR);
+			break;
+		default:
+			in_byte(port + UART_MSR);
+			break;
+		}
+	}
+}
+
+/*======================================================================*
+                           serial_read
+ *----------------------------------------------------------------------*
+ 把收到的字节全部翻译成键值，一批交给 in_process_batch。
+ *======================================================================*/
+PUBLIC void serial_read(TTY *p_tty)
+{
+	SERIAL *p_serial = p_tty->p_serial;
+	KEY_EVENT events[SERIAL_RX_BYTES];
+	int nr_events = 0;
+	int done;
+	u32 key;
+
+	while (p_serial->rx_tail != p_serial->rx_head)
+	{
+		key = serial_byte_to_key(p_serial->rx_buf[p_serial->rx_tail & (SERIAL_RX_BYTES - 1)]);
+		p_serial->rx_tail++;
+		if (key)
+		{
+			events[nr_events].key = key;
+			events[nr_events].count = 1;
+			nr_events++;
+		}
+		if (nr_events == SERIAL_RX_BYTES)
+		{
+			break;
+		}
+	}
+
+	/* 串口的输入总是属于这个 TTY，切换控制台也不影响 */
+	for (done = 0; done < nr_events;)
+	{
+		done += in_process_batch(p_tty, events + done, nr_events - done);
+	}
+}
+
+/*======================================================================*
+                           serial_write
+ *----------------------------------------------------------------------*
+ 把字符放进发送缓冲区，发送器空闲时立即开始发送。
+ '\n' 转成 "\r\n"，'\b' 转成 "\b \b"，和屏幕上的效果一致。
+ *======================================================================*/
+PUBLIC void serial_write(SERIAL *p_serial, char *buf, int len)
+{
+	disable_int();
+	while (len--)
+	{
+		char ch = *buf++;
+		if (ch == '\n')
+		{
+			serial_tx_put(p_serial, '\r');
+			serial_tx_put(p_serial, '\n');
+		}
+		else if (ch == '\b')
+		{
+			serial_tx_put(p_serial, '\b');
+			serial_tx_put(p_serial, ' ');
+			serial_tx_put(p_serial, '\b');
+		}
+		else
+		{
+			serial_tx_put(p_serial, ch);
+		}
+	}
+	if (!p_serial->tx_busy)
+	{
+		serial_tx_fill(p_serial);
+	}
+	enable_int();
+}
+
+/*======================================================================*
+                           serial_tx_put
+ *======================================================================*/
+PRIVATE void serial_tx_put(SERIAL *p_serial, char ch)
+{
+	if (p_serial->tx_head - p_serial->tx_tail < SERIAL_TX_BYTES)
+	{
+		p_serial->tx_buf[p_serial->tx_head & (SERIAL_TX_BYTES - 1)] = ch;
+		p_serial->tx_head++;
+	}
+	else
+	{
+		p_serial->tx_overflow++;
+	}
+}
+
+/*======================================================================*
+                           serial_tx_fill
+ *----------------------------------------------------------------------*
+ 发送 FIFO 已空：一次填入最多 UART_FIFO_SIZE 个字节。
+ *======================================================================*/
+PRIVATE void serial_tx_fill(SERIAL *p_serial)
+{
+	int n = 0;
+
+	while (n < UART_FIFO_SIZE && p_serial->tx_tail != p_serial->tx_head)
+	{
+		out_byte(p_serial->port + UART_THR,
+				 p_serial->tx_buf[p_serial->tx_tail & (SERIAL_TX_BYTES - 1)]);
+		p_serial->tx_tail++;
+		n++;
+	}
+
+	/* 没有东西可发时，下一次 serial_write 负责重新启动发送 */
+	p_serial->tx_busy = (n > 0);
+}
+
+/*======================================================================*
+                           serial_byte_to_key
+ *----------------------------------------------------------------------*
+ 把终端发来的字节翻译成和键盘一样的键值，0 表示忽略。
+ *======================================================================*/
+PRIVATE u32 serial_byte_to_key(u8 ch)
+{
+	switch (ch)
+	{
+	case '\r':
+	case '\n':
+		return ENTER;
+	case '\b':
+	case 0x7F:
+		return BACKSPACE;
+	case '\t':
+		return TAB;
+	case 0x1B:
+		return ESC;
+	default:
+		break;
+	}
+
+	/* Ctrl+A ~ Ctrl+Z */
+	if (ch >= 0x01 && ch <= 0x1A)
+	{
+		return (ch - 0x01 + 'a') | FLAG_CTRL_L;
+	}
+	if (ch >= ' ' && ch < 0x7F)
+	{
+		return ch;
+	}
+
+	return 0;
+}
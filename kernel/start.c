@@ -12,6 +12,7 @@
 #include "proc.h"
 #include "tty.h"
 #include "console.h"
+#include "serial.h"
 #include "global.h"
 #include "proto.h"
 
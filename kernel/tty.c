@@ -12,46 +12,84 @@
 #include "proc.h"
 #include "tty.h"
 #include "console.h"
+#include "serial.h"
 #include "global.h"
 #include "keyboard.h"
+#include "search.h"
 #include "proto.h"
 
 #define TTY_FIRST (tty_table)
 #define TTY_END (tty_table + NR_CONSOLES)
 
+// 放进输入缓冲区的标记，回显到这里时保存、恢复屏幕或者画出搜索结果。
+// 不会和键值重复
+#define ECHO_SHOW_RESULTS (FLAG_EXT | 0xFD)
+#define ECHO_SAVE_SCREEN (FLAG_EXT | 0xFE)
+#define ECHO_RESTORE_SCREEN (FLAG_EXT | 0xFF)
+
+// 每行至少占控制台的一行，行数不会超过 CON_ROWS
+#if EDIT_NR_LINES < CON_ROWS
+#error "EDIT_NR_LINES must not be less than CON_ROWS"
+#endif
+
+// NR_CONSOLES 个 EDIT 要放得进 EDIT_BASE 开始的区域，放不下时这里编译出错
+typedef char edit_region_check[NR_CONSOLES * sizeof(EDIT) <= EDIT_REGION_BYTES ? 1 : -1];
+
 PRIVATE void init_tty(TTY *p_tty);
 PRIVATE void tty_do_read(TTY *p_tty);
 PRIVATE void tty_do_write(TTY *p_tty);
 PRIVATE void put_key(TTY *p_tty, u32 key);
+PRIVATE void echo_char(TTY *p_tty, u32 key);
+PRIVATE void echo_out(TTY *p_tty, char ch);
+PRIVATE void batch_stat_add(BATCH_STAT *p_stat, u32 n);
+PRIVATE void report_replay(TTY *p_tty);
 
-// 清空屏幕
-PRIVATE void clear_screen(TTY *p_tty);
-// 退格方法
-PRIVATE void do_backspace(TTY *p_tty);
-
-// 输入模式
-// int MODE_INPUT = 0;
-// 搜索模式
-// int MODE_SEARCH = 1;
-
-// 当前状态
-int current_mode;
-// 之前状态
-int before_mode;
-// 缓存输入的字符，用于搜索
-char buf[80 * 25];
-int p_buf;
-// 每一行长度
-int line_length[25 * 2];
-int current_line;
-// 搜索模式的输入
-char search_buf[80 * 25];
-int p_search_buf;
-// 搜索是否已完成
-int indexs[80 * 25];
-int search_has_done;
-// 计时器
-int time_counter;
+// 编辑缓存(gap buffer)
+PRIVATE void reset_edit_buf(EDIT *p_edit);
+PRIVATE char edit_at(EDIT *p_edit, int i);
+PRIVATE void edit_move_gap(EDIT *p_edit, int pos);
+PRIVATE int glyph_cells(char ch);
+PRIVATE int col_advance(int col, char ch);
+PRIVATE int line_cols(EDIT *p_edit, int from, int to, int col);
+PRIVATE int line_rows(int cells, int width);
+// 行索引
+PRIVATE int back_slot(EDIT *p_edit, int line);
+PRIVATE int line_start_of(EDIT *p_edit, int line);
+PRIVATE int line_row_of(EDIT *p_edit, int line);
+PRIVATE int rows_after(EDIT *p_edit, int line);
+PRIVATE int edit_locate(EDIT *p_edit, int i, int width, int *p_col);
+PRIVATE int cursor_pos(EDIT *p_edit, int width);
+PRIVATE void edit_touch(EDIT *p_edit);
+PRIVATE void serial_echo(TTY *p_tty, char ch, int n);
+PRIVATE int edit_room(TTY *p_tty, int rows);
+PRIVATE int edit_put(TTY *p_tty, char ch);
+PRIVATE int edit_cut(TTY *p_tty);
+PRIVATE void edit_goto(TTY *p_tty, int pos);
+PRIVATE void edit_insert(TTY *p_tty, char ch);
+PRIVATE void edit_backspace(TTY *p_tty);
+PRIVATE void edit_delete(TTY *p_tty);
+PRIVATE void edit_left(TTY *p_tty);
+PRIVATE void edit_right(TTY *p_tty);
+PRIVATE void edit_home(TTY *p_tty);
+PRIVATE void edit_end(TTY *p_tty);
+PRIVATE void render_edit(TTY *p_tty);
+// 撤销和重做
+PRIVATE void undo_record(EDIT *p_edit, int kind, int pos, char ch);
+PRIVATE char undo_char_at(EDIT *p_edit, UNDO_OP *p_op, int k);
+PRIVATE void edit_undo(TTY *p_tty);
+PRIVATE void edit_redo(TTY *p_tty);
+PRIVATE int render_glyph(CONSOLE *p_con, char ch, int col, int color);
+// 增量搜索
+PRIVATE int search_full(TTY *p_tty, char ch);
+PRIVATE void search_screen_enter(TTY *p_tty);
+PRIVATE void search_screen_leave(TTY *p_tty);
+PRIVATE void search_begin(EDIT *p_edit);
+PRIVATE void search_extend(EDIT *p_edit, char ch);
+PRIVATE void search_backspace(TTY *p_tty);
+PRIVATE void repaint_marks(TTY *p_tty);
+PRIVATE void render_results(TTY *p_tty);
+// 换屏幕大小
+PRIVATE void change_mode(TTY *p_tty, int mode);
 
 /*======================================================================*
                            task_tty
@@ -62,60 +100,44 @@ PUBLIC void task_tty()
 
 	init_keyboard();
 
-	for (p_tty = TTY_FIRST; p_tty < TTY_END; p_tty++)
+	for (p_tty = TTY_FIRST; p_tty < TTY_FIRST + NR_BOOT_CONSOLES; p_tty++)
 	{
 		init_tty(p_tty);
 	}
 	select_console(0);
 
-	// 初始为输入模式
-	current_mode = 0;
-	before_mode = 0;
-	// 开始计时
-	// -60 * 1000是为了先清屏一次
-	time_counter = get_ticks() - 60 * 1000;
-	// 初始化缓存区指针
-	p_buf = 0;
-	int i;
-	for (i = 0; i < 80 * 25; ++i)
-	{
-		buf[i] = 0;
-	}
-	// 初始化每一行的长度
-	for (i = 0; i < 25 * 2; ++i)
-	{
-		line_length[i] = 0;
-	}
-	current_line = 0;
+	init_serial();
+	attach_serial(&tty_table[SERIAL_TTY], 0);
 
 	while (1)
 	{
 		for (p_tty = TTY_FIRST; p_tty < TTY_END; p_tty++)
 		{
+			EDIT *p_edit = p_tty->p_edit;
+
+			// 还没有打开的控制台
+			if (!p_tty->p_console)
+			{
+				continue;
+			}
+
 			tty_do_read(p_tty);
 			tty_do_write(p_tty);
+			report_replay(p_tty);
 
 			// 处在输入模式并且超过20s则清屏
 			// 时间似乎是错乱的，所以凑合一下，选一个比较稳定的数
 			// @See [[kernal/clock.c]]
 			int current_time = get_ticks();
-			if (current_mode == 0 &&
-				((current_time - time_counter) * 1000 / HZ) > 60 * 1000)
+			if (p_edit->current_mode == 0 &&
+				((current_time - p_edit->time_counter) * 1000 / HZ) > 60 * 1000)
 			{
-				clear_screen(p_tty);
-				// 重置缓存和每一行长度，否则会导致退格异常
-				p_buf = 0;
-				for (i = 0; i < 80 * 25; ++i)
-				{
-					buf[i] = 0;
-				}
-				for (i = 0; i < 25 * 2; ++i)
-				{
-					line_length[i] = 0;
-				}
+				clear_console(p_tty->p_console);
+				// 重置编辑缓存，光标回到开头
+				reset_edit_buf(p_edit);
 				// 重置计时器
 				// 但是可以预见，这种方式的误差会越来越大，因为调用需要时间
-				time_counter = current_time;
+				p_edit->time_counter = current_time;
 			}
 		}
 	}
@@ -128,15 +150,62 @@ PRIVATE void init_tty(TTY *p_tty)
 {
 	p_tty->inbuf_count = 0;
 	p_tty->p_inbuf_head = p_tty->p_inbuf_tail = p_tty->in_buf;
+	p_tty->p_serial = 0;
+
+	memset(&p_tty->read_stat, 0, sizeof(BATCH_STAT));
+	memset(&p_tty->write_stat, 0, sizeof(BATCH_STAT));
+
+	/* 每个 TTY 有自己的编辑缓存和搜索状态，放在 EDIT_BASE 开始的 RAM 中 */
+	p_tty->p_edit = (EDIT *)EDIT_BASE + (p_tty - tty_table);
+	memset(p_tty->p_edit, 0, sizeof(EDIT));
+	reset_edit_buf(p_tty->p_edit);
+	// 初始为输入模式
+	p_tty->p_edit->current_mode = 0;
+	p_tty->p_edit->before_mode = 0;
+	// 开始计时
+	// -60 * 1000是为了先清屏一次
+	p_tty->p_edit->time_counter = get_ticks() - 60 * 1000;
 
 	init_screen(p_tty);
 }
 
+/*======================================================================*
+				in_process_batch
+ *----------------------------------------------------------------------*
+ 把一批键依次交给 in_process，每个事件重复 count 次。某个键切换了控制台
+ 时就停下来，剩下的键应当由调用者交给新的当前控制台。
+ 返回处理了多少个事件。
+ *======================================================================*/
+PUBLIC int in_process_batch(TTY *p_tty, KEY_EVENT *events, int nr_events)
+{
+	int console = nr_current_console;
+	int i;
+	int j;
+
+	for (i = 0; i < nr_events;)
+	{
+		for (j = 0; j < events[i].count; j++)
+		{
+			in_process(p_tty, events[i].key);
+		}
+		i++;
+		if (nr_current_console != console)
+		{
+			break;
+		}
+	}
+
+	batch_stat_add(&p_tty->read_stat, i);
+
+	return i;
+}
+
 /*======================================================================*
 				in_process
  *======================================================================*/
 PUBLIC void in_process(TTY *p_tty, u32 key)
 {
+	EDIT *p_edit = p_tty->p_edit;
 	char output[2] = {'\0', '\0'};
 
 	if (!(key & FLAG_EXT))
@@ -146,53 +215,44 @@ PUBLIC void in_process(TTY *p_tty, u32 key)
 			((key & FLAG_CTRL_L) || (key & FLAG_CTRL_R)))
 		{
 			// 搜索完成时屏蔽输入
-			if (search_has_done == 1)
+			if (p_edit->search_has_done == 1)
 			{
 				;
 			}
+			// 搜索模式下撤销相当于对搜索内容退格
+			else if (p_edit->current_mode == 1)
+			{
+				search_backspace(p_tty);
+			}
 			else
 			{
-				// 撤销退格
-				if (buf[p_buf + 1] == '\b')
-				{
-					put_key(p_tty, buf[p_buf]);
-					++p_buf;
-				}
-				// 其他情况下撤销相当于退格
-				else
-				{
-					do_backspace(p_tty);
-				}
+				edit_undo(p_tty);
+			}
+		}
+		// 重做
+		else if ((key & MASK_RAW) == 'y' &&
+				 ((key & FLAG_CTRL_L) || (key & FLAG_CTRL_R)))
+		{
+			// 只在输入模式下响应
+			if (p_edit->current_mode == 0)
+			{
+				edit_redo(p_tty);
 			}
 		}
 		else
 		{
 			// 只在输入模式下响应
-			if (current_mode == 0)
-			{
-				put_key(p_tty, key);
-				// 可输出字符加入缓存
-				// 假设不会溢出
-				buf[p_buf] = key;
-				++p_buf;
-				// 普通字符长度 + 1
-				if (line_length[current_line] + 1 > 80)
-				{
-					int temp = line_length[current_line];
-					line_length[current_line] = 80;
-					++current_line;
-					line_length[current_line] = temp + 1 - 80;
-				}
-				else
-				{
-					++line_length[current_line];
-				}
+			if (p_edit->current_mode == 0)
+			{
+				// 可输出字符插入到光标处
+				edit_insert(p_tty, key);
 			}
 			// 搜索模式的输入是另外一种输入（会被自动清空的输入）
 			else
 			{
-				// 搜索完成时屏蔽输入
-				if (search_has_done == 1)
+				// 搜索完成或者搜索内容占满了一行时屏蔽输入
+				if (p_edit->search_has_done == 1 ||
+					search_full(p_tty, key))
 				{
 					;
 				}
@@ -200,9 +260,10 @@ PUBLIC void in_process(TTY *p_tty, u32 key)
 				{
 					put_key(p_tty, key);
 					// 可输出字符加入搜索缓存
-					// 假设不会溢出
-					search_buf[p_search_buf] = key;
-					++p_search_buf;
+					p_edit->search_buf[p_edit->p_search_buf] = key;
+					++p_edit->p_search_buf;
+					// 边输入边搜索
+					search_extend(p_edit, key);
 				}
 			}
 		}
@@ -214,144 +275,114 @@ PUBLIC void in_process(TTY *p_tty, u32 key)
 		{
 		case ENTER:
 			// 输入模式的ENTER是换行
-			if (current_mode == 0)
+			if (p_edit->current_mode == 0)
 			{
-				put_key(p_tty, '\n');
-				// 下一行
-				++current_line;
-				// 特殊字符\n加入缓存
-				buf[p_buf] = '\n';
-				++p_buf;
+				edit_insert(p_tty, '\n');
 			}
 			// 搜索模式的ENTER是确认
 			// 所以这也默认了搜索模式不会出现换行（
 			else
 			{
 				// 搜索完成时屏蔽输入
-				if (search_has_done == 1)
+				if (p_edit->search_has_done == 1)
 				{
 					;
 				}
 				else
 				{
 					// 只搜索现在有效的字符，而不是搜索整个缓冲区
-					int input_length = p_buf;
-					int search_length = strlen(search_buf);
-					// 初始化找到的index
-					int i;
-					for (i = 0; i < 80 * 25; ++i)
-					{
-						indexs[i] = 0;
-					}
-					// 进行搜索
-					for (i = 0; i < input_length - search_length + 1; ++i)
-					{
-						int is_equal = 1;
-						int j;
-						for (j = 0; j < search_length; ++j)
-						{
-							if (buf[i + j] != search_buf[j])
-							{
-								is_equal = 0;
-								break;
-							}
-						}
-						if (is_equal)
-						{
-							// 考虑搜索到的内容重合，使用这种方式可以重复标记
-							for (j = 0; j < search_length; ++j)
-							{
-								indexs[i + j] = 1;
-							}
-						}
-					}
+					int input_length = p_edit->p_buf;
+					int search_length = p_edit->p_search_buf;
+					// 标记所有匹配，重叠的匹配也都标记上
+					search_mark(p_edit->buf, input_length,
+								p_edit->search_buf, search_length,
+								p_edit->indexs, SEARCH_AUTO);
 					// 搜索完成，交给输出函数进行处理
-					search_has_done = 1;
-					clear_screen(p_tty);
-					put_key(p_tty, '\n');
+					p_edit->search_has_done = 1;
+					put_key(p_tty, ECHO_SHOW_RESULTS);
 				}
 			}
 			break;
 		// 两种模式都支持退格
 		case BACKSPACE:
 			// 搜索完成时屏蔽输入
-			if (search_has_done == 1)
+			if (p_edit->search_has_done == 1)
 			{
 				;
 			}
+			// 搜索模式的退格只改搜索内容
+			else if (p_edit->current_mode == 1)
+			{
+				search_backspace(p_tty);
+			}
 			else
 			{
-				// 特殊字符\b加入缓存，为了支持撤销
-				// 不移动指针
-				buf[p_buf] = '\b';
-				// ++p_buf;
-				put_key(p_tty, '\b');
-				// 退格对当前行和缓存的处理移到后面
+				edit_backspace(p_tty);
 			}
 			break;
 		// 处理TAB
 		case TAB:
-			// 搜索完成时屏蔽输入
-			if (search_has_done == 1)
+			// 输入模式的TAB
+			if (p_edit->current_mode == 0)
+			{
+				edit_insert(p_tty, '\t');
+			}
+			// 搜索完成或者搜索内容占满了一行时屏蔽输入
+			else if (p_edit->search_has_done == 1 ||
+					 search_full(p_tty, '\t'))
 			{
 				;
 			}
+			// 搜索模式的TAB
 			else
 			{
 				put_key(p_tty, '\t');
-				// 输入模式的TAB
-				if (current_mode == 0)
-				{
-					// TAB换行
-					if (line_length[current_line] + 4 > 80)
-					{
-						int temp = line_length[current_line];
-						line_length[current_line] = 80;
-						++current_line;
-						line_length[current_line] = temp + 4 - 80;
-					}
-					else
-					{
-						line_length[current_line] += 4;
-					}
-					// 特殊字符\t加入缓存
-					buf[p_buf] = '\t';
-					++p_buf;
-				}
-				// 搜索模式的TAB
-				else
-				{
-					// 加入搜索缓存
-					search_buf[p_search_buf] = '\t';
-					++p_search_buf;
-				}
+				// 加入搜索缓存
+				p_edit->search_buf[p_edit->p_search_buf] = '\t';
+				++p_edit->p_search_buf;
+				search_extend(p_edit, '\t');
 			}
 			break;
 		// 处理ESC
 		case ESC:
 			// 更新之前的模式
-			before_mode = current_mode;
+			p_edit->before_mode = p_edit->current_mode;
 			// 如果现在是输入模式，进入搜索模式
 			// 如果现在是搜索模式，返回输入模式
-			current_mode = current_mode == 0 ? 1 : 0;
+			p_edit->current_mode = p_edit->current_mode == 0 ? 1 : 0;
 			// 切换模式时初始化搜索输入
 			int i;
-			for (i = 0; i < 80 * 25; ++i)
+			for (i = 0; i < EDIT_SEARCH_BYTES; ++i)
+			{
+				p_edit->search_buf[i] = 0;
+			}
+			for (i = 0; i < EDIT_BUF_BYTES; ++i)
 			{
-				search_buf[i] = 0;
-				indexs[i] = 0;
+				p_edit->indexs[i] = 0;
 			}
-			p_search_buf = 0;
+			p_edit->p_search_buf = 0;
 			// 重置搜索状态
-			search_has_done = 0;
-			// 切换后回到输入模式，先清空屏幕
-			if (current_mode == 0 &&
-				before_mode == 1)
+			p_edit->search_has_done = 0;
+			// 进入搜索模式时，缓存中的每个位置都是候选
+			// 搜索要求缓存是连续的，先把 gap 挪到最后
+			if (p_edit->current_mode == 1)
+			{
+				p_edit->saved_cursor = p_edit->gap_start;
+				edit_move_gap(p_edit, p_edit->p_buf);
+				search_begin(p_edit);
+			}
+			// 切换后回到输入模式，光标回到原来的位置，重新开始计时
+			if (p_edit->current_mode == 0 &&
+				p_edit->before_mode == 1)
 			{
-				time_counter = get_ticks();
-				clear_screen(p_tty);
-				put_key(p_tty, 0x1B);
+				edit_move_gap(p_edit, p_edit->saved_cursor);
+				p_edit->time_counter = get_ticks();
 			}
+			// 切换回来之后的输入另起一次操作
+			p_edit->undo_sealed = 1;
+			// 回显到这里时保存或恢复屏幕，是哪一个现在就定好
+			put_key(p_tty, p_edit->current_mode == 1 ?
+							   ECHO_SAVE_SCREEN : ECHO_RESTORE_SCREEN);
 			break;
 		case UP:
 			if ((key & FLAG_SHIFT_L) || (key & FLAG_SHIFT_R))
@@ -365,6 +396,63 @@ PUBLIC void in_process(TTY *p_tty, u32 key)
 				scroll_screen(p_tty->p_console, SCR_UP);
 			}
 			break;
+		/* Shift + PageUp/PageDown/Home/End: 翻看历史 */
+		case PAGEUP:
+			if ((key & FLAG_SHIFT_L) || (key & FLAG_SHIFT_R))
+			{
+				scroll_history(p_tty->p_console,
+							   -p_tty->p_console->height);
+			}
+			break;
+		case PAGEDOWN:
+			if ((key & FLAG_SHIFT_L) || (key & FLAG_SHIFT_R))
+			{
+				scroll_history(p_tty->p_console,
+							   p_tty->p_console->height);
+			}
+			break;
+		case HOME:
+			if ((key & FLAG_SHIFT_L) || (key & FLAG_SHIFT_R))
+			{
+				scroll_history(p_tty->p_console,
+							   -(CON_HIST_LINES + p_tty->p_console->nr_rows));
+			}
+			// 输入模式下光标到行首
+			else if (p_edit->current_mode == 0)
+			{
+				edit_home(p_tty);
+			}
+			break;
+		case END:
+			if ((key & FLAG_SHIFT_L) || (key & FLAG_SHIFT_R))
+			{
+				scroll_live(p_tty->p_console);
+			}
+			// 输入模式下光标到行尾
+			else if (p_edit->current_mode == 0)
+			{
+				edit_end(p_tty);
+			}
+			break;
+		// 输入模式下移动光标、删除光标处的字符
+		case LEFT:
+			if (p_edit->current_mode == 0)
+			{
+				edit_left(p_tty);
+			}
+			break;
+		case RIGHT:
+			if (p_edit->current_mode == 0)
+			{
+				edit_right(p_tty);
+			}
+			break;
+		case DELETE:
+			if (p_edit->current_mode == 0)
+			{
+				edit_delete(p_tty);
+			}
+			break;
 		case F1:
 		case F2:
 		case F3:
@@ -380,8 +468,38 @@ PUBLIC void in_process(TTY *p_tty, u32 key)
 			/* Alt + F1~F12 */
 			if ((key & FLAG_ALT_L) || (key & FLAG_ALT_R))
 			{
+				// 第一次切换过去时才打开
+				if (!tty_table[raw_code - F1].p_console)
+				{
+					init_tty(&tty_table[raw_code - F1]);
+				}
 				select_console(raw_code - F1);
 			}
+			/* Ctrl + F1~F3: 80x25、80x50、90x60
+			 * Ctrl + F9~F12: 录制、导出、回放扫描码 */
+			else if ((key & FLAG_CTRL_L) || (key & FLAG_CTRL_R))
+			{
+				if (raw_code >= F1 && raw_code <= F3)
+				{
+					change_mode(p_tty, CON_MODE_80x25 + (raw_code - F1));
+				}
+				else if (raw_code == F9)
+				{
+					kb_toggle_capture();
+				}
+				else if (raw_code == F10)
+				{
+					kb_trace_dump(p_tty);
+				}
+				else if (raw_code == F11)
+				{
+					kb_start_replay(KB_REPLAY_TIMED);
+				}
+				else if (raw_code == F12)
+				{
+					kb_start_replay(KB_REPLAY_FAST);
+				}
+			}
 			break;
 		default:
 			break;
@@ -394,6 +512,11 @@ PUBLIC void in_process(TTY *p_tty, u32 key)
 *======================================================================*/
 PRIVATE void put_key(TTY *p_tty, u32 key)
 {
+	// 满了先把缓冲区中的回显掉，一个键也不丢
+	if (p_tty->inbuf_count == TTY_IN_BYTES)
+	{
+		tty_do_write(p_tty);
+	}
 	if (p_tty->inbuf_count < TTY_IN_BYTES)
 	{
 		*(p_tty->p_inbuf_head) = key;
@@ -415,6 +538,10 @@ PRIVATE void tty_do_read(TTY *p_tty)
 	{
 		keyboard_read(p_tty);
 	}
+	if (p_tty->p_serial)
+	{
+		serial_read(p_tty);
+	}
 }
 
 /*======================================================================*
@@ -422,9 +549,12 @@ PRIVATE void tty_do_read(TTY *p_tty)
  *======================================================================*/
 PRIVATE void tty_do_write(TTY *p_tty)
 {
-	if (p_tty->inbuf_count)
+	int n = 0;
+
+	/* 一次输出缓冲区中所有的字符 */
+	while (p_tty->inbuf_count)
 	{
-		char ch = *(p_tty->p_inbuf_tail);
+		u32 key = *(p_tty->p_inbuf_tail);
 		p_tty->p_inbuf_tail++;
 		if (p_tty->p_inbuf_tail == p_tty->in_buf + TTY_IN_BYTES)
 		{
@@ -432,135 +562,185 @@ PRIVATE void tty_do_write(TTY *p_tty)
 		}
 		p_tty->inbuf_count--;
 
-		// 搜索模式
-		if (search_has_done == 1)
+		echo_char(p_tty, key);
+		n++;
+	}
+
+	/* 输入模式下这一批编辑一次画出来 */
+	if (!p_tty->p_edit->screen_saved)
+	{
+		render_edit(p_tty);
+	}
+
+	if (p_tty->p_edit->results_dirty)
+	{
+		render_results(p_tty);
+	}
+
+	/* 回显都写完之后再改高亮，免得被后面回显的字符盖掉 */
+	if (p_tty->p_edit->marks_dirty &&
+		p_tty->p_edit->current_mode == 1 && !p_tty->p_edit->search_has_done)
+	{
+		repaint_marks(p_tty);
+	}
+
+	if (n)
+	{
+		batch_stat_add(&p_tty->write_stat, n);
+	}
+}
+
+/*======================================================================*
+			      echo_char
+*======================================================================*/
+PRIVATE void echo_char(TTY *p_tty, u32 key)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	char ch = key;
+
+	// 进入搜索模式时保存屏幕，回到输入模式时恢复
+	if (key == ECHO_SAVE_SCREEN)
+	{
+		if (!p_edit->screen_saved)
 		{
-			// 只搜索现在有效的字符，而不是搜索整个缓冲区
-			int input_length = p_buf;
-			int search_length = strlen(search_buf);
-			int i;
-			for (i = 0; i < input_length; ++i)
-			{
-				// 如果是搜索结果
-				if (indexs[i] == 1)
-				{
-					// TAB和空格用白底来体现
-					if (buf[i] == '\t')
-					{
-						out_char(p_tty->p_console, ' ', 2);
-						out_char(p_tty->p_console, ' ', 2);
-						out_char(p_tty->p_console, ' ', 2);
-						out_char(p_tty->p_console, ' ', 2);
-					}
-					else if (buf[i] == ' ')
-					{
-						out_char(p_tty->p_console, ' ', 2);
-					}
-					// 其他的是红字
-					else
-					{
-						out_char(p_tty->p_console, buf[i], 1);
-					}
-				}
-				// 不是搜索结果就正常输出
-				else
-				{
-					// TAB还是4个空格
-					if (buf[i] == '\t')
-					{
-						out_char(p_tty->p_console, ' ', 0);
-						out_char(p_tty->p_console, ' ', 0);
-						out_char(p_tty->p_console, ' ', 0);
-						out_char(p_tty->p_console, ' ', 0);
-					}
-					else
-					{
-						out_char(p_tty->p_console, buf[i], 0);
-					}
-				}
-			}
-			// 同时还要输出搜索内容本身
-			for (i = 0; i < search_length; ++i)
-			{
-				// TAB和空格用白底来体现
-				if (search_buf[i] == '\t')
-				{
-					out_char(p_tty->p_console, ' ', 2);
-					out_char(p_tty->p_console, ' ', 2);
-					out_char(p_tty->p_console, ' ', 2);
-					out_char(p_tty->p_console, ' ', 2);
-				}
-				else if (search_buf[i] == ' ')
-				{
-					out_char(p_tty->p_console, ' ', 2);
-				}
-				// 其他的是红字
-				else
-				{
-					out_char(p_tty->p_console, search_buf[i], 1);
-				}
-			}
-			// // 关闭搜索模式
-			// search_has_done = 0;
+			search_screen_enter(p_tty);
+		}
+	}
+	else if (key == ECHO_RESTORE_SCREEN)
+	{
+		if (p_edit->screen_saved)
+		{
+			search_screen_leave(p_tty);
 		}
-		// 搜索模式向非搜索模式切换
-		else if (ch == 0x1B)
+	}
+	// 搜索完成，结果在这一批字符都回显完之后一次画出来
+	else if (key == ECHO_SHOW_RESULTS)
+	{
+		p_edit->results_dirty = 1;
+	}
+	// 搜索内容的回显，输入模式的编辑由 render_edit 画
+	else
+	{
+		// TAB需要输出4个空格
+		if (ch == '\t')
 		{
-			int input_length = strlen(buf);
 			int i;
-			for (i = 0; i < input_length; ++i)
+			for (i = 0; i < EDIT_TAB_CELLS; ++i)
 			{
-				// TAB还是4个空格
-				if (buf[i] == '\t')
-				{
-					out_char(p_tty->p_console, ' ', 0);
-					out_char(p_tty->p_console, ' ', 0);
-					out_char(p_tty->p_console, ' ', 0);
-					out_char(p_tty->p_console, ' ', 0);
-				}
-				else
-				{
-					out_char(p_tty->p_console, buf[i], 0);
-				}
+				echo_out(p_tty, ' ');
 			}
 		}
-		// 非搜索模式
+		// 其他字符直接输出，搜索内容的退格已经在 search_backspace 中退掉了
 		else
 		{
-			// TAB需要输出4个空格
-			if (ch == '\t')
-			{
-				int i;
-				for (i = 0; i < 4; ++i)
-				{
-					out_char(p_tty->p_console, ' ', 0);
-				}
-			}
-			else if (ch == '\b')
-			{
-				do_backspace(p_tty);
-			}
-			// 其他字符直接输出
-			else
-			{
-				out_char(p_tty->p_console, ch, 0);
-			}
+			echo_out(p_tty, ch);
 		}
 	}
 }
 
+/*======================================================================*
+			      echo_out
+ *----------------------------------------------------------------------*
+ 回显一个字符，挂了串口的 TTY 同时从串口发出去。
+*======================================================================*/
+PRIVATE void echo_out(TTY *p_tty, char ch)
+{
+	out_char(p_tty->p_console, ch, 0);
+	if (p_tty->p_serial)
+	{
+		serial_write(p_tty->p_serial, &ch, 1);
+	}
+}
+
+/*======================================================================*
+			      batch_stat_add
+*======================================================================*/
+PRIVATE void batch_stat_add(BATCH_STAT *p_stat, u32 n)
+{
+	p_stat->nr_batches++;
+	p_stat->nr_items += n;
+	p_stat->last = n;
+	if (n > p_stat->max)
+	{
+		p_stat->max = n;
+	}
+}
+
+/*======================================================================*
+                              report_replay
+ *----------------------------------------------------------------------*
+ 扫描码回放结束并且回显都已写完之后，报告一共处理了多少键、用了多少
+ ticks，以及折合每秒多少键。
+ *======================================================================*/
+PRIVATE void report_replay(TTY *p_tty)
+{
+	char msg[80];
+	u32 keys;
+	int used;
+
+	if (!kb_replay_poll(&keys, &used))
+	{
+		return;
+	}
+
+	if (used < 1)
+	{
+		used = 1;
+	}
+	sprintf(msg, "\nreplay: %d keys, %d ticks, %d keys/s\n",
+		keys, used, keys * HZ / used);
+	tty_write(p_tty, msg, strlen(msg));
+}
+
 /*======================================================================*
                               tty_write
+ *----------------------------------------------------------------------*
+ 输出写在编辑区原来的位置上，编辑区挪到输出之后的新的一行，下次整个
+ 重画。还没有输入时不用挪，输出接着光标写。搜索模式下先回到输入时的
+ 屏幕，写完再重新进入。
 *======================================================================*/
 PUBLIC void tty_write(TTY *p_tty, char *buf, int len)
 {
-	char *p = buf;
-	int i = len;
+	CONSOLE *p_con = p_tty->p_console;
+	EDIT *p_edit = p_tty->p_edit;
+	int saved = p_edit->screen_saved;
+	unsigned int pos;
+
+	if (saved)
+	{
+		search_screen_leave(p_tty);
+	}
+
+	if (p_edit->p_buf > 0 || p_edit->end_pos > 0)
+	{
+		fill_region(p_con, p_con->edit_base, p_edit->end_pos, ' ', 0);
+		set_cursor_pos(p_con, p_con->edit_base);
+	}
+
+	out_string(p_con, buf, len, 0);
+
+	pos = p_con->cursor - p_con->original_addr;
+	p_con->edit_base = (pos + p_con->width - 1) / p_con->width *
+		p_con->width;
+	edit_room(p_tty, p_edit->nr_rows);
+	p_edit->end_pos = 0;
+	if (p_edit->p_buf > 0)
+	{
+		// 新的位置上原来的内容也要擦掉
+		p_edit->end_pos = p_edit->nr_rows * p_con->width;
+		p_edit->dirty_from = 0;
+	}
 
-	while (i)
+	// 搜索结果在新的位置上重画
+	if (saved)
 	{
-		out_char(p_tty->p_console, *p++, 0);
-		i--;
+		search_screen_enter(p_tty);
+		p_edit->results_dirty = 1;
+	}
+
+	if (p_tty->p_serial)
+	{
+		serial_write(p_tty->p_serial, buf, len);
 	}
 }
 
@@ -573,132 +753,1076 @@ PUBLIC int sys_write(char *buf, int len, PROCESS *p_proc)
 	return 0;
 }
 
-// 输出\b来清屏……
-PRIVATE void clear_screen(TTY *p_tty)
+// 换屏幕大小，屏幕清空了，编辑缓存和搜索状态也从头开始
+PRIVATE void change_mode(TTY *p_tty, int mode)
 {
-	int i;
-	for (i = 0; i < 80 * 25 * 2; ++i)
+	EDIT *p_edit = p_tty->p_edit;
+
+	set_console_mode(p_tty->p_console, mode);
+	// 还没回显的也不用回显了
+	p_tty->inbuf_count = 0;
+	p_tty->p_inbuf_head = p_tty->p_inbuf_tail = p_tty->in_buf;
+
+	reset_edit_buf(p_edit);
+	p_edit->current_mode = 0;
+	p_edit->before_mode = 0;
+	p_edit->p_search_buf = 0;
+	p_edit->search_has_done = 0;
+	p_edit->marks_dirty = 0;
+	p_edit->results_dirty = 0;
+	p_edit->screen_saved = 0;
+	p_edit->time_counter = get_ticks();
+}
+
+/*======================================================================*
+			      reset_edit_buf
+ *----------------------------------------------------------------------*
+ 清空编辑缓存，只剩一个空行，光标回到控制台的开头。
+ *======================================================================*/
+PRIVATE void reset_edit_buf(EDIT *p_edit)
+{
+	p_edit->p_buf = 0;
+	p_edit->gap_start = 0;
+	p_edit->gap_end = EDIT_BUF_BYTES;
+	p_edit->saved_cursor = 0;
+
+	p_edit->line_start[0] = 0;
+	p_edit->line_row[0] = 0;
+	p_edit->nr_lines = 1;
+	p_edit->cur_line = 0;
+	p_edit->cur_col = 0;
+	p_edit->cur_cells = 0;
+	p_edit->nr_rows = 1;
+
+	p_edit->end_pos = 0;
+	p_edit->dirty_from = -1;
+	p_edit->cursor_dirty = 0;
+
+	p_edit->undo_first = 0;
+	p_edit->undo_top = 0;
+	p_edit->undo_end = 0;
+	p_edit->undo_head = 0;
+	p_edit->undo_sealed = 1;
+}
+
+/*======================================================================*
+			      edit_at
+ *----------------------------------------------------------------------*
+ 缓存中的第 i 个字符，跳过 gap。
+ *======================================================================*/
+PRIVATE char edit_at(EDIT *p_edit, int i)
+{
+	if (i < p_edit->gap_start)
 	{
-		out_char(p_tty->p_console, '\b', 0);
+		return p_edit->buf[i];
 	}
+	return p_edit->buf[i + p_edit->gap_end - p_edit->gap_start];
 }
 
-// 处理退格
-PRIVATE void do_backspace(TTY *p_tty)
+/*======================================================================*
+			      edit_move_gap
+ *----------------------------------------------------------------------*
+ 把 gap 挪到第 pos 个字符前面，只搬动 gap 两边之间的字符。
+ 行索引不变，跨过 '\n' 时由调用者搬动索引。
+ *======================================================================*/
+PRIVATE void edit_move_gap(EDIT *p_edit, int pos)
 {
-	// 输入模式的退格
-	if (current_mode == 0)
+	while (p_edit->gap_start > pos)
 	{
-		// 回到缓存真正的头部，同时要避免越界
-		// 无论如何，当前字符都要退出缓存
-		if (p_buf > 0)
-		{
-			--p_buf;
-		}
-		// TAB需要退4格
-		// 不知道为啥TAB变成0x9了
-		if (buf[p_buf] == 0x9)
-		{
-			int i;
-			for (i = 0; i < 4; ++i)
-			{
-				out_char(p_tty->p_console, '\b', 0);
-			}
+		p_edit->buf[--p_edit->gap_end] = p_edit->buf[--p_edit->gap_start];
+	}
+	while (p_edit->gap_start < pos)
+	{
+		p_edit->buf[p_edit->gap_start++] = p_edit->buf[p_edit->gap_end++];
+	}
+}
 
-			// TAB换行
-			if (line_length[current_line] - 4 < 0)
-			{
-				int temp = line_length[current_line];
-				line_length[current_line] = 0;
-				// 防止越界
-				if (current_line - 1 >= 0)
-				{
-					--current_line;
-					if (line_length[current_line] - (4 - temp) >= 0)
-					{
-						line_length[current_line] = line_length[current_line] - (4 - temp);
-					}
-				}
-			}
-			else
-			{
-				line_length[current_line] -= 4;
-			}
+// 搜索内容的回显不按制表位，一个字符固定占几格
+PRIVATE int glyph_cells(char ch)
+{
+	return ch == '\t' ? EDIT_TAB_CELLS : 1;
+}
+
+// 在第 col 列放下 ch 之后到了第几列，'\n' 另外处理
+PRIVATE int col_advance(int col, char ch)
+{
+	if (ch == '\t')
+	{
+		return (col / EDIT_TAB_CELLS + 1) * EDIT_TAB_CELLS;
+	}
+	return col + 1;
+}
+
+// 从第 col 列的第 from 个字符排到第 to 个字符(或者行尾)之前，到了第几列
+PRIVATE int line_cols(EDIT *p_edit, int from, int to, int col)
+{
+	char ch;
+
+	for (; from < to && (ch = edit_at(p_edit, from)) != '\n'; from++)
+	{
+		col = col_advance(col, ch);
+	}
+	return col;
+}
+
+// 占 cells 格的一行在屏幕上占几行，'\n' 总是换到下一行
+PRIVATE int line_rows(int cells, int width)
+{
+	return cells / width + 1;
+}
+
+// 光标之后的第 line 行在索引数组中的位置
+PRIVATE int back_slot(EDIT *p_edit, int line)
+{
+	return EDIT_NR_LINES - (p_edit->nr_lines - line);
+}
+
+// 第 line 行的行首是第几个字符
+PRIVATE int line_start_of(EDIT *p_edit, int line)
+{
+	if (line <= p_edit->cur_line)
+	{
+		return p_edit->line_start[line];
+	}
+	return p_edit->p_buf - p_edit->line_start[back_slot(p_edit, line)];
+}
+
+// 第 line 行从屏幕上的第几行开始
+PRIVATE int line_row_of(EDIT *p_edit, int line)
+{
+	if (line <= p_edit->cur_line)
+	{
+		return p_edit->line_row[line];
+	}
+	return p_edit->nr_rows - p_edit->line_row[back_slot(p_edit, line)];
+}
+
+// 光标之后从第 line 行起的各行一共占几行。这些行记的是到末尾的行数，
+// 光标所在的行变长变短时不用改
+PRIVATE int rows_after(EDIT *p_edit, int line)
+{
+	if (line < p_edit->nr_lines)
+	{
+		return p_edit->line_row[back_slot(p_edit, line)];
+	}
+	return 0;
+}
+
+/*======================================================================*
+			      edit_locate
+ *----------------------------------------------------------------------*
+ 第 i 个字符在屏幕上的位置(从编辑区的开头算起)，*p_col 是它在行中的列。
+ 二分查找它所在的行，再从行首数出列。
+ *======================================================================*/
+PRIVATE int edit_locate(EDIT *p_edit, int i, int width, int *p_col)
+{
+	int lo = 0;
+	int hi = p_edit->nr_lines - 1;
+
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+
+		if (line_start_of(p_edit, mid) <= i)
+		{
+			lo = mid;
 		}
-		// ENTER需要退一行
-		// 不知道为啥ENTER变成0xA了
-		else if (buf[p_buf] == 0xA)
+		else
 		{
-			int i;
-			line_length[current_line] = 0;
-			// 防止越界
-			if (current_line - 1 >= 0)
-			{
-				--current_line;
-			}
-			for (i = 0; i < 80 - line_length[current_line]; ++i)
+			hi = mid - 1;
+		}
+	}
+
+	*p_col = line_cols(p_edit, line_start_of(p_edit, lo), i, 0);
+	return line_row_of(p_edit, lo) * width + *p_col;
+}
+
+// 光标在屏幕上的位置(从编辑区的开头算起)
+PRIVATE int cursor_pos(EDIT *p_edit, int width)
+{
+	return p_edit->line_row[p_edit->cur_line] * width + p_edit->cur_col;
+}
+
+// 光标处的内容要变了，从这里开始屏幕上的内容要重画
+PRIVATE void edit_touch(EDIT *p_edit)
+{
+	if (p_edit->dirty_from < 0 || p_edit->gap_start < p_edit->dirty_from)
+	{
+		p_edit->dirty_from = p_edit->gap_start;
+	}
+}
+
+// 串口那边只回显在末尾的输入和退格
+PRIVATE void serial_echo(TTY *p_tty, char ch, int n)
+{
+	if (p_tty->p_serial)
+	{
+		while (n-- > 0)
+		{
+			serial_write(p_tty->p_serial, &ch, 1);
+		}
+	}
+}
+
+/*======================================================================*
+			      edit_room
+ *----------------------------------------------------------------------*
+ 编辑区要占 rows 行，下面还要留一行给搜索内容。控制台在编辑区下面放
+ 不下时，把编辑区上面的行挤进历史记录；上面的行都挤掉了还放不下就返回 0。
+ *======================================================================*/
+PRIVATE int edit_room(TTY *p_tty, int rows)
+{
+	CONSOLE *p_con = p_tty->p_console;
+	int top = p_con->edit_base / p_con->width;
+	int need = top + rows + 1 - p_con->nr_rows;
+
+	if (need <= 0)
+	{
+		return 1;
+	}
+	if (need > top)
+	{
+		return 0;
+	}
+	// 一次挤到编辑区上面只剩一屏，免得每多一行就搬一次控制台
+	if (need < top - (p_con->height - 1))
+	{
+		need = top - (p_con->height - 1);
+	}
+	// 刚离开搜索模式，屏幕还没恢复，要在搬动之前恢复
+	if (p_tty->p_edit->screen_saved)
+	{
+		search_screen_leave(p_tty);
+	}
+	push_rows(p_con, need);
+	return 1;
+}
+
+/*======================================================================*
+			      edit_put
+ *----------------------------------------------------------------------*
+ 在光标处放一个字符，不记撤销日志。缓存满了或者控制台放不下返回 0。
+ '\n' 把光标所在的行分成两行，新的一行放在索引前半部分的末尾。
+ *======================================================================*/
+PRIVATE int edit_put(TTY *p_tty, char ch)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	int width = p_tty->p_console->width;
+	int cells;
+	int rows;
+
+	if (p_edit->p_buf == EDIT_BUF_BYTES ||
+		(ch == '\n' && p_edit->nr_lines == EDIT_NR_LINES))
+	{
+		return 0;
+	}
+
+	// 先算出放下之后光标所在的行占多少格、一共占几行。
+	// 光标之后的 TAB 可能换了制表位，重新数这一行剩下的部分
+	cells = line_cols(p_edit, p_edit->gap_start, p_edit->p_buf,
+					  ch == '\n' ? 0 : col_advance(p_edit->cur_col, ch));
+	rows = p_edit->line_row[p_edit->cur_line] + line_rows(cells, width) +
+		rows_after(p_edit, p_edit->cur_line + 1);
+	if (ch == '\n')
+	{
+		rows += line_rows(p_edit->cur_col, width);
+	}
+	if (!edit_room(p_tty, rows))
+	{
+		return 0;
+	}
+
+	edit_touch(p_edit);
+	p_edit->buf[p_edit->gap_start++] = ch;
+	++p_edit->p_buf;
+
+	if (ch == '\n')
+	{
+		int row = p_edit->line_row[p_edit->cur_line] +
+			line_rows(p_edit->cur_col, width);
+
+		++p_edit->nr_lines;
+		++p_edit->cur_line;
+		p_edit->line_start[p_edit->cur_line] = p_edit->gap_start;
+		p_edit->line_row[p_edit->cur_line] = row;
+		p_edit->cur_col = 0;
+	}
+	else
+	{
+		p_edit->cur_col = col_advance(p_edit->cur_col, ch);
+	}
+	p_edit->cur_cells = cells;
+	p_edit->nr_rows = rows;
+
+	p_edit->cursor_dirty = 1;
+	return 1;
+}
+
+/*======================================================================*
+			      edit_cut
+ *----------------------------------------------------------------------*
+ 删掉光标处的字符，光标不动，不记撤销日志。没有字符或者控制台放不下
+ 返回 0。删掉 '\n' 时下一行接到这一行后面，它在索引后半部分的那一项
+ 不要了。接上的行中的 TAB 换了制表位，宽度不是 4 的倍数时可能多占一行。
+ *======================================================================*/
+PRIVATE int edit_cut(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	int line = p_edit->cur_line + 1;	/* 之后不变的第一行 */
+	int cells;
+	int rows;
+
+	if (p_edit->gap_end == EDIT_BUF_BYTES)
+	{
+		return 0;
+	}
+
+	if (p_edit->buf[p_edit->gap_end] == '\n')
+	{
+		line++;
+	}
+	cells = line_cols(p_edit, p_edit->gap_start + 1, p_edit->p_buf,
+					  p_edit->cur_col);
+	rows = p_edit->line_row[p_edit->cur_line] +
+		line_rows(cells, p_tty->p_console->width) +
+		rows_after(p_edit, line);
+	if (rows > p_edit->nr_rows && !edit_room(p_tty, rows))
+	{
+		return 0;
+	}
+
+	edit_touch(p_edit);
+	if (p_edit->buf[p_edit->gap_end] == '\n')
+	{
+		--p_edit->nr_lines;
+	}
+	++p_edit->gap_end;
+	--p_edit->p_buf;
+
+	p_edit->cur_cells = cells;
+	p_edit->nr_rows = rows;
+	return 1;
+}
+
+/*======================================================================*
+			      edit_goto
+ *----------------------------------------------------------------------*
+ 光标移到第 pos 个字符前面。
+ *======================================================================*/
+PRIVATE void edit_goto(TTY *p_tty, int pos)
+{
+	EDIT *p_edit = p_tty->p_edit;
+
+	while (p_edit->gap_start > pos)
+	{
+		edit_left(p_tty);
+	}
+	while (p_edit->gap_start < pos && p_edit->gap_end < EDIT_BUF_BYTES)
+	{
+		edit_right(p_tty);
+	}
+}
+
+/*======================================================================*
+			      edit_insert
+ *----------------------------------------------------------------------*
+ 在光标处插入一个字符。缓存满了或者控制台放不下了就不再接受输入。
+ *======================================================================*/
+PRIVATE void edit_insert(TTY *p_tty, char ch)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	int at_end = (p_edit->gap_end == EDIT_BUF_BYTES);
+	int col = p_edit->cur_col;
+
+	if (!edit_put(p_tty, ch))
+	{
+		return;
+	}
+	undo_record(p_edit, UNDO_INSERT, p_edit->gap_start - 1, ch);
+
+	if (at_end)
+	{
+		serial_echo(p_tty, ch == '\t' ? ' ' : ch,
+					ch == '\t' ? p_edit->cur_col - col : 1);
+	}
+}
+
+/*======================================================================*
+			      edit_backspace
+ *----------------------------------------------------------------------*
+ 删掉光标前的字符。
+ *======================================================================*/
+PRIVATE void edit_backspace(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	int at_end = (p_edit->gap_end == EDIT_BUF_BYTES);
+	int sealed = p_edit->undo_sealed;
+	int col = p_edit->cur_col;
+	char ch;
+
+	if (p_edit->gap_start == 0)
+	{
+		return;
+	}
+
+	ch = p_edit->buf[p_edit->gap_start - 1];
+	// 左移会另起一次操作，连续的退格还要接在一起
+	edit_left(p_tty);
+	if (!edit_cut(p_tty))
+	{
+		edit_right(p_tty);
+		p_edit->undo_sealed = sealed;
+		return;
+	}
+	p_edit->undo_sealed = sealed;
+	undo_record(p_edit, UNDO_BACKSPACE, p_edit->gap_start, ch);
+
+	if (at_end && ch != '\n')
+	{
+		serial_echo(p_tty, '\b', col - p_edit->cur_col);
+	}
+}
+
+/*======================================================================*
+			      edit_delete
+ *----------------------------------------------------------------------*
+ 删掉光标处的字符，光标不动。
+ *======================================================================*/
+PRIVATE void edit_delete(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	char ch;
+
+	if (p_edit->gap_end == EDIT_BUF_BYTES)
+	{
+		return;
+	}
+
+	ch = p_edit->buf[p_edit->gap_end];
+	if (!edit_cut(p_tty))
+	{
+		return;
+	}
+	undo_record(p_edit, UNDO_DELETE, p_edit->gap_start, ch);
+}
+
+/*======================================================================*
+			      edit_left
+ *----------------------------------------------------------------------*
+ 光标左移一个字符。跨过 '\n' 时光标所在的行搬到索引的后半部分，
+ 光标到上一行的行尾；跨过 TAB 时从行首重新数列。
+ *======================================================================*/
+PRIVATE void edit_left(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	int line = p_edit->cur_line;
+	char ch;
+
+	if (p_edit->gap_start == 0)
+	{
+		return;
+	}
+
+	edit_move_gap(p_edit, p_edit->gap_start - 1);
+	ch = p_edit->buf[p_edit->gap_end];
+
+	if (ch == '\n')
+	{
+		int start = p_edit->p_buf - p_edit->line_start[line];
+		int row = p_edit->nr_rows - p_edit->line_row[line];
+
+		p_edit->line_start[back_slot(p_edit, line)] = start;
+		p_edit->line_row[back_slot(p_edit, line)] = row;
+		p_edit->cur_line = line - 1;
+		p_edit->cur_col = line_cols(p_edit, p_edit->line_start[line - 1],
+									p_edit->gap_start, 0);
+		p_edit->cur_cells = p_edit->cur_col;
+	}
+	else if (ch == '\t')
+	{
+		p_edit->cur_col = line_cols(p_edit, p_edit->line_start[line],
+									p_edit->gap_start, 0);
+	}
+	else
+	{
+		--p_edit->cur_col;
+	}
+	p_edit->cursor_dirty = 1;
+	p_edit->undo_sealed = 1;
+}
+
+/*======================================================================*
+			      edit_right
+ *----------------------------------------------------------------------*
+ 光标右移一个字符。跨过 '\n' 时下一行从索引的后半部分搬到前半部分。
+ *======================================================================*/
+PRIVATE void edit_right(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	char ch;
+
+	if (p_edit->gap_end == EDIT_BUF_BYTES)
+	{
+		return;
+	}
+
+	ch = p_edit->buf[p_edit->gap_end];
+	edit_move_gap(p_edit, p_edit->gap_start + 1);
+
+	if (ch == '\n')
+	{
+		int line = p_edit->cur_line + 1;
+		int start = line_start_of(p_edit, line);
+		int row = line_row_of(p_edit, line);
+
+		p_edit->cur_line = line;
+		p_edit->line_start[line] = start;
+		p_edit->line_row[line] = row;
+		p_edit->cur_col = 0;
+		p_edit->cur_cells = line_cols(p_edit, p_edit->gap_start,
+									  p_edit->p_buf, 0);
+	}
+	else
+	{
+		p_edit->cur_col = col_advance(p_edit->cur_col, ch);
+	}
+	p_edit->cursor_dirty = 1;
+	p_edit->undo_sealed = 1;
+}
+
+/*======================================================================*
+			      edit_home
+ *======================================================================*/
+PRIVATE void edit_home(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+
+	edit_move_gap(p_edit, p_edit->line_start[p_edit->cur_line]);
+	p_edit->cur_col = 0;
+	p_edit->cursor_dirty = 1;
+	p_edit->undo_sealed = 1;
+}
+
+/*======================================================================*
+			      edit_end
+ *======================================================================*/
+PRIVATE void edit_end(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	int end = p_edit->p_buf;
+
+	if (p_edit->cur_line + 1 < p_edit->nr_lines)
+	{
+		end = line_start_of(p_edit, p_edit->cur_line + 1) - 1;
+	}
+	edit_move_gap(p_edit, end);
+	p_edit->cur_col = p_edit->cur_cells;
+	p_edit->cursor_dirty = 1;
+	p_edit->undo_sealed = 1;
+}
+
+/*======================================================================*
+			      render_edit
+ *----------------------------------------------------------------------*
+ 把编辑画到屏幕上。只重画从第一个改动的字符到末尾的部分，前面的内容
+ 在屏幕上的位置没有变；末尾比原来短时擦掉多出来的格子。最后放好光标。
+ 两个位置都从行索引得到。
+ *======================================================================*/
+PRIVATE void render_edit(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	CONSOLE *p_con = p_tty->p_console;
+	int base = p_con->edit_base;
+	int col;
+	int i;
+
+	if (p_edit->dirty_from >= 0)
+	{
+		render_begin(p_con, base + edit_locate(p_edit, p_edit->dirty_from,
+											   p_con->width, &col));
+		for (i = p_edit->dirty_from; i < p_edit->p_buf; i++)
+		{
+			col = render_glyph(p_con, edit_at(p_edit, i), col, 0);
+		}
+		p_edit->end_pos = render_end(p_con, base + p_edit->end_pos) - base;
+		p_edit->dirty_from = -1;
+		p_edit->cursor_dirty = 1;
+	}
+
+	if (p_edit->cursor_dirty)
+	{
+		set_cursor_pos(p_con, base + cursor_pos(p_edit, p_con->width));
+		p_edit->cursor_dirty = 0;
+	}
+}
+
+/*======================================================================*
+			      render_glyph
+ *----------------------------------------------------------------------*
+ 在行中的第 col 列画一个字符，TAB 画成到下一个制表位的空格。
+ 返回画完之后的列。
+ *======================================================================*/
+PRIVATE int render_glyph(CONSOLE *p_con, char ch, int col, int color)
+{
+	int next;
+
+	if (ch == '\n')
+	{
+		render_char(p_con, ch, color);
+		return 0;
+	}
+
+	next = col_advance(col, ch);
+	if (ch == '\t')
+	{
+		for (; col < next; col++)
+		{
+			render_char(p_con, ' ', color);
+		}
+	}
+	else
+	{
+		render_char(p_con, ch, color);
+	}
+	return next;
+}
+
+/*======================================================================*
+			      undo_record
+ *----------------------------------------------------------------------*
+ 记下一次编辑：在 pos 处插入了 ch，或者删掉了 pos 处的 ch。
+ 和上一次操作是同一种、位置接得上、中间没有停顿时接到上一次操作后面，
+ 这样一次连续的输入(或粘贴)撤销时是一次操作。新的编辑丢掉可以重做的部分。
+ *======================================================================*/
+PRIVATE void undo_record(EDIT *p_edit, int kind, int pos, char ch)
+{
+	int now = get_ticks();
+	UNDO_OP *p_op = 0;
+
+	if (!p_edit->undo_sealed &&
+		p_edit->undo_top == p_edit->undo_end &&
+		p_edit->undo_top > p_edit->undo_first &&
+		now - p_edit->undo_tick <= UNDO_BURST_TICKS)
+	{
+		p_op = &p_edit->undo_ops[(p_edit->undo_top - 1) % UNDO_NR_OPS];
+		if (p_op->kind != kind ||
+			p_op->text + p_op->len != p_edit->undo_head ||
+			!((kind == UNDO_INSERT && p_op->pos + p_op->len == pos) ||
+			  (kind == UNDO_DELETE && p_op->pos == pos) ||
+			  (kind == UNDO_BACKSPACE && p_op->pos == pos + 1)))
+		{
+			p_op = 0;
+		}
+	}
+
+	if (p_op)
+	{
+		// 退格是往前删的，起点跟着往前
+		if (kind == UNDO_BACKSPACE)
+		{
+			p_op->pos = pos;
+		}
+	}
+	else
+	{
+		// 另起一次操作，满了就丢掉最早的
+		p_edit->undo_end = p_edit->undo_top;
+		if (p_edit->undo_end - p_edit->undo_first == UNDO_NR_OPS)
+		{
+			p_edit->undo_first++;
+		}
+		p_op = &p_edit->undo_ops[p_edit->undo_end % UNDO_NR_OPS];
+		p_op->kind = kind;
+		p_op->pos = pos;
+		p_op->len = 0;
+		p_op->text = p_edit->undo_head;
+		p_edit->undo_end++;
+		p_edit->undo_top = p_edit->undo_end;
+	}
+
+	p_edit->undo_text[p_edit->undo_head & (UNDO_TEXT_BYTES - 1)] = ch;
+	p_edit->undo_head++;
+	p_op->len++;
+
+	// 字符被新写的盖掉了的操作不能再撤销
+	while (p_edit->undo_first < p_edit->undo_end &&
+		   p_edit->undo_head - p_edit->undo_ops[p_edit->undo_first % UNDO_NR_OPS].text >
+			   UNDO_TEXT_BYTES)
+	{
+		p_edit->undo_first++;
+	}
+	if (p_edit->undo_top < p_edit->undo_first)
+	{
+		p_edit->undo_top = p_edit->undo_first;
+	}
+
+	p_edit->undo_sealed = 0;
+	p_edit->undo_tick = now;
+}
+
+// 操作中按缓存顺序的第 k 个字符
+PRIVATE char undo_char_at(EDIT *p_edit, UNDO_OP *p_op, int k)
+{
+	if (p_op->kind == UNDO_BACKSPACE)
+	{
+		k = p_op->len - 1 - k;
+	}
+	return p_edit->undo_text[(p_op->text + k) & (UNDO_TEXT_BYTES - 1)];
+}
+
+/*======================================================================*
+			      edit_undo
+ *----------------------------------------------------------------------*
+ 撤销最近的一次操作，光标回到操作之前的位置。
+ *======================================================================*/
+PRIVATE void edit_undo(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	UNDO_OP *p_op;
+	int i;
+
+	if (p_edit->undo_top == p_edit->undo_first)
+	{
+		return;
+	}
+	p_op = &p_edit->undo_ops[--p_edit->undo_top % UNDO_NR_OPS];
+
+	edit_goto(p_tty, p_op->pos);
+	if (p_op->kind == UNDO_INSERT)
+	{
+		for (i = 0; i < p_op->len; i++)
+		{
+			edit_cut(p_tty);
+		}
+	}
+	else
+	{
+		for (i = 0; i < p_op->len; i++)
+		{
+			edit_put(p_tty, undo_char_at(p_edit, p_op, i));
+		}
+		// DELETE 时光标在删掉的字符前面
+		if (p_op->kind == UNDO_DELETE)
+		{
+			edit_goto(p_tty, p_op->pos);
+		}
+	}
+	p_edit->undo_sealed = 1;
+}
+
+/*======================================================================*
+			      edit_redo
+ *======================================================================*/
+PRIVATE void edit_redo(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	UNDO_OP *p_op;
+	int i;
+
+	if (p_edit->undo_top == p_edit->undo_end)
+	{
+		return;
+	}
+	p_op = &p_edit->undo_ops[p_edit->undo_top++ % UNDO_NR_OPS];
+
+	edit_goto(p_tty, p_op->pos);
+	if (p_op->kind == UNDO_INSERT)
+	{
+		for (i = 0; i < p_op->len; i++)
+		{
+			edit_put(p_tty, undo_char_at(p_edit, p_op, i));
+		}
+	}
+	else
+	{
+		for (i = 0; i < p_op->len; i++)
+		{
+			edit_cut(p_tty);
+		}
+	}
+	p_edit->undo_sealed = 1;
+}
+
+// 搜索内容的回显要留在保存的那一屏中，最多占一行少一格
+PRIVATE int search_full(TTY *p_tty, char ch)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	int cells = glyph_cells(ch);
+	int i;
+
+	for (i = 0; i < p_edit->p_search_buf; i++)
+	{
+		cells += glyph_cells(p_edit->search_buf[i]);
+	}
+	return cells > p_tty->p_console->width - 1 ||
+		   p_edit->p_search_buf + 1 >= EDIT_SEARCH_BYTES;
+}
+
+/*======================================================================*
+			      search_screen_enter
+ *----------------------------------------------------------------------*
+ 进入搜索模式时的屏幕：先把还没画出来的编辑画上，屏幕滚到能看见输入的
+ 末尾和它的下一行，搜索内容接在末尾后面，然后保存这一屏。搜索模式只改
+ 这一屏中的格子，回到输入模式时一次复制就能恢复。
+ *======================================================================*/
+PRIVATE void search_screen_enter(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	CONSOLE *p_con = p_tty->p_console;
+	unsigned int end;
+
+	render_edit(p_tty);
+	end = p_con->edit_base + p_edit->end_pos;
+	set_cursor_pos(p_con, (end / p_con->width + 1) * p_con->width);
+	set_cursor_pos(p_con, end);
+	save_screen(p_con);
+	p_edit->screen_saved = 1;
+}
+
+/*======================================================================*
+			      search_screen_leave
+ *======================================================================*/
+PRIVATE void search_screen_leave(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+
+	// 还没画出来的搜索结果不用再画了
+	p_edit->results_dirty = 0;
+	restore_screen(p_tty->p_console);
+	p_edit->screen_saved = 0;
+	// 光标回到编辑的光标处
+	p_edit->cursor_dirty = 1;
+}
+
+/*======================================================================*
+			      search_begin
+ *----------------------------------------------------------------------*
+ 增量搜索。cand[0..level_end[k]) 是与搜索内容前 k 个字符匹配的起始位置，
+ 每输入一个字符就把它们分成还匹配的(放在前面)和不再匹配的两部分，
+ 退格时只要退回上一层，不用重新扫描。
+ *======================================================================*/
+PRIVATE void search_begin(EDIT *p_edit)
+{
+	int i;
+
+	for (i = 0; i < p_edit->p_buf; i++)
+	{
+		p_edit->cand[i] = i;
+	}
+	p_edit->level_end[0] = p_edit->p_buf;
+	p_edit->search_level = 0;
+	p_edit->marks_dirty = 0;
+}
+
+/*======================================================================*
+			      search_extend
+ *======================================================================*/
+PRIVATE void search_extend(EDIT *p_edit, char ch)
+{
+	int k = p_edit->search_level;
+	int last = p_edit->p_buf - 1 - k;	/* 起始位置超过它就放不下 k + 1 个字符 */
+	int w = 0;
+	int r;
+
+	if (k >= EDIT_SEARCH_BYTES)
+	{
+		return;
+	}
+
+	for (r = 0; r < p_edit->level_end[k]; r++)
+	{
+		u16 pos = p_edit->cand[r];
+
+		if (pos <= last && p_edit->buf[pos + k] == ch)
+		{
+			/* 交换而不是覆盖，不再匹配的位置要留给退格用 */
+			p_edit->cand[r] = p_edit->cand[w];
+			p_edit->cand[w] = pos;
+			w++;
+		}
+	}
+
+	p_edit->level_end[k + 1] = w;
+	p_edit->search_level = k + 1;
+	p_edit->marks_dirty = 1;
+}
+
+/*======================================================================*
+			      search_backspace
+ *======================================================================*/
+PRIVATE void search_backspace(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	int i;
+
+	// 退到底不再处理，否则会影响之前输入的内容
+	if (p_edit->p_search_buf == 0)
+	{
+		return;
+	}
+
+	--p_edit->p_search_buf;
+	// TAB需要退4格
+	for (i = glyph_cells(p_edit->search_buf[p_edit->p_search_buf]); i > 0; i--)
+	{
+		put_key(p_tty, '\b');
+	}
+	p_edit->search_buf[p_edit->p_search_buf] = 0;
+
+	if (p_edit->search_level > 0)
+	{
+		p_edit->search_level--;
+		p_edit->marks_dirty = 1;
+	}
+}
+
+/*======================================================================*
+			      repaint_marks
+ *----------------------------------------------------------------------*
+ 按当前的候选位置重新计算 indexs，只给高亮状态变了的字符改颜色。
+ 缓存的内容在屏幕上是从编辑区的开头按 render_edit 的规则排下来的。
+ 只改 search_screen_enter 保存的那一屏中的格子。
+ *======================================================================*/
+PRIVATE void repaint_marks(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	CONSOLE *p_con = p_tty->p_console;
+	unsigned int top = p_con->snap_start - p_con->original_addr;
+	unsigned int bottom = top + p_con->screen_size;
+	int k = p_edit->search_level;
+	int reach = 0;		/* 已知的匹配最远覆盖到哪里 */
+	unsigned int pos = p_con->edit_base;	/* 当前字符在控制台中的位置 */
+	int col = 0;		/* 当前字符在行中的列 */
+	int i;
+
+	p_edit->marks_dirty = 0;
+
+	/* 先用第 1 位标出匹配的起点 */
+	if (k > 0)
+	{
+		for (i = 0; i < p_edit->level_end[k]; i++)
+		{
+			p_edit->indexs[p_edit->cand[i]] |= 2;
+		}
+	}
+
+	for (i = 0; i < p_edit->p_buf; i++)
+	{
+		char ch = p_edit->buf[i];
+		u8 mark;
+		int n;
+
+		if (p_edit->indexs[i] & 2)
+		{
+			reach = i + k;
+		}
+		mark = (i < reach);
+
+		if (ch == '\n')
+		{
+			// 和 render_char 一样，最后一行的换行到控制台的末尾为止
+			pos = p_con->width * (pos / p_con->width + 1);
+			if (pos > p_con->v_mem_limit - 1)
 			{
-				out_char(p_tty->p_console, '\b', 0);
+				pos = p_con->v_mem_limit - 1;
 			}
+			col = 0;
+			p_edit->indexs[i] = mark;
+			continue;
 		}
-		// 其他情况退一格
-		else
+
+		// TAB 排到下一个制表位
+		n = col_advance(col, ch) - col;
+		col += n;
+		if (mark != (p_edit->indexs[i] & 1))
 		{
-			out_char(p_tty->p_console, '\b', 0);
-			// 普通字符 - 1
-			if (line_length[current_line] - 1 < 0)
+			int color = !mark ? 0 : ((ch == ' ' || ch == '\t') ? 2 : 1);
+			int j;
+
+			for (j = 0; j < n; j++)
 			{
-				line_length[current_line] = 0;
-				// 防止越界
-				if (current_line - 1 >= 0)
+				if (pos + j >= top && pos + j < bottom)
 				{
-					--current_line;
-					if (line_length[current_line] - 1 >= 0)
-					{
-						--line_length[current_line];
-					}
+					set_char_color(p_con, pos + j, color);
 				}
 			}
-			else
-			{
-				--line_length[current_line];
-			}
 		}
-		// 为了撤销，不能清除，直接移动指针即可
-		// buf[p_buf] = 0;
+		p_edit->indexs[i] = mark;
+
+		pos += n;
+		if (pos > p_con->v_mem_limit - 1)
+		{
+			pos = p_con->v_mem_limit - 1;
+		}
 	}
-	// 搜索模式的退格
-	else
+}
+
+/*======================================================================*
+			      render_results
+ *----------------------------------------------------------------------*
+ 画出搜索结果：缓存的内容，匹配的部分红字(空格和 TAB 白底)，后面跟着
+ 搜索内容本身。只有变了的格子才会写到显存里。
+ 和 repaint_marks 一样只画保存的那一屏，输入的末尾总在这一屏中，
+ 只要跳过这一屏上面的字符。
+ *======================================================================*/
+PRIVATE void render_results(TTY *p_tty)
+{
+	EDIT *p_edit = p_tty->p_edit;
+	CONSOLE *p_con = p_tty->p_console;
+	unsigned int top = p_con->snap_start - p_con->original_addr;
+	unsigned int pos = p_con->edit_base;
+	unsigned int next;
+	unsigned int end;
+	int col = 0;
+	int i;
+
+	p_edit->results_dirty = 0;
+
+	for (i = 0; i < p_edit->p_buf; ++i)
 	{
-		// 回到缓存真正的头部，同时要避免越界
-		// 无论如何，当前字符都要退出缓存
-		if (p_search_buf > 0)
+		char ch = p_edit->buf[i];
+
+		if (ch == '\n')
 		{
-			--p_search_buf;
+			next = p_con->width * (pos / p_con->width + 1);
 		}
-		// 退到底不再处理，否则会影响之前输入的内容
 		else
 		{
-			return;
-		}
-		// TAB需要退4格
-		// 不知道为啥TAB变成0x9了
-		if (search_buf[p_search_buf] == 0x9)
-		{
-			int i;
-			for (i = 0; i < 4; ++i)
-			{
-				out_char(p_tty->p_console, '\b', 0);
-			}
+			next = pos + col_advance(col, ch) - col;
 		}
-		// 其他情况退一格
-		else
+		if (next > top)
 		{
-			out_char(p_tty->p_console, '\b', 0);
+			break;
 		}
-		// 为了撤销，不能清除，直接移动指针即可
-		// search_buf[p_search_buf] = 0;
+		pos = next;
+		col = (ch == '\n') ? 0 : col_advance(col, ch);
+	}
+	// 跨进这一屏的 TAB 只画屏幕上的部分
+	if (pos < top)
+	{
+		col += top - pos;
+		pos = top;
+	}
+
+	render_begin(p_con, pos);
+	for (; i < p_edit->p_buf; ++i)
+	{
+		char ch = p_edit->buf[i];
+		// 不是搜索结果就正常输出，是的话TAB和空格用白底来体现，其他的是红字
+		int color = !(p_edit->indexs[i] & 1) ? 0 : ((ch == ' ' || ch == '\t') ? 2 : 1);
+
+		col = render_glyph(p_con, ch, col, color);
+	}
+	// 同时还要输出搜索内容本身，TAB 和回显的时候一样固定占 4 格
+	for (i = 0; i < p_edit->p_search_buf; ++i)
+	{
+		char ch = p_edit->search_buf[i];
+
+		render_glyph(p_con, ch, 0, (ch == ' ' || ch == '\t') ? 2 : 1);
 	}
+	// 光标之后的格子都是空白，擦到原来的光标为止
+	end = render_end(p_con, p_con->cursor - p_con->original_addr);
+	set_cursor_pos(p_con, end);
 }
 
 // 字符串比较函数
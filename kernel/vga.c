@@ -0,0 +1,190 @@
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                              vga.c
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                                                    Forrest Yu, 2005
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+/*
+	文本模式的切换。
+	80x25 是 BIOS 留下的模式，用 8x16 的字体；80x50 和 90x60 用 8x8 的字体，
+	字体由 BIOS 的 8x16 字体每两行合成一行得到，放在字体区 1。
+	90x60 用 8 点宽的字符和 640x480 的行时序。
+*/
+
+#include "type.h"
+#include "const.h"
+#include "protect.h"
+#include "string.h"
+#include "proc.h"
+#include "tty.h"
+#include "console.h"
+#include "serial.h"
+#include "global.h"
+#include "proto.h"
+
+/* 一个文本模式的全部寄存器 */
+typedef struct s_vga_regs
+{
+	u8	misc;		/* Miscellaneous Output */
+	u8	seq[5];		/* Sequencer 0~4 */
+	u8	crtc[25];	/* CRT Controller 0~0x18 */
+	u8	gc[9];		/* Graphics Controller 0~8 */
+	u8	ac[21];		/* Attribute Controller 0~0x14 */
+}VGA_REGS;
+
+#define FONT_SLOT	32	/* 字体区中每个字符占的字节数 */
+#define FONT8_BANK	0x4000	/* 字体区 1 在 plane 2 中的位置 */
+
+PRIVATE void write_regs(const VGA_REGS* p_regs);
+PRIVATE void make_font8();
+
+PRIVATE const VGA_REGS vga_modes[NR_CON_MODES] = {
+	/* CON_MODE_80x25 */
+	{0x67,
+	 {0x03, 0x00, 0x03, 0x00, 0x02},
+	 {0x5F, 0x4F, 0x50, 0x82, 0x55, 0x81, 0xBF, 0x1F,
+	  0x00, 0x4F, 0x0D, 0x0E, 0x00, 0x00, 0x00, 0x00,
+	  0x9C, 0x8E, 0x8F, 0x28, 0x1F, 0x96, 0xB9, 0xA3, 0xFF},
+	 {0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x00, 0xFF},
+	 {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+	  0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+	  0x0C, 0x00, 0x0F, 0x08, 0x00}},
+	/* CON_MODE_80x50: 时序同 80x25，每个字符 8 行，用字体区 1 */
+	{0x67,
+	 {0x03, 0x00, 0x03, 0x05, 0x02},
+	 {0x5F, 0x4F, 0x50, 0x82, 0x55, 0x81, 0xBF, 0x1F,
+	  0x00, 0x47, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00,
+	  0x9C, 0x8E, 0x8F, 0x28, 0x1F, 0x96, 0xB9, 0xA3, 0xFF},
+	 {0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x00, 0xFF},
+	 {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+	  0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+	  0x0C, 0x00, 0x0F, 0x08, 0x00}},
+	/* CON_MODE_90x60: 28MHz 点时钟，8 点宽的字符，480 行 */
+	{0xE7,
+	 {0x03, 0x01, 0x03, 0x05, 0x02},
+	 {0x6B, 0x59, 0x5A, 0x82, 0x60, 0x8D, 0x0B, 0x3E,
+	  0x00, 0x47, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00,
+	  0xEA, 0x0C, 0xDF, 0x2D, 0x08, 0xE8, 0x05, 0xA3, 0xFF},
+	 {0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x00, 0xFF},
+	 {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+	  0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+	  0x0C, 0x00, 0x0F, 0x00, 0x00}}
+};
+
+/* 8x8 的字体是不是已经做好了 */
+PRIVATE int font8_ready = 0;
+
+/*======================================================================*
+                           vga_set_mode
+ *----------------------------------------------------------------------*
+ 把显卡切换到 mode(CON_MODE_80x25 等)。显存中的文字不变，
+ 光标和显示起始地址被清零，由调用者重新设置。
+ *======================================================================*/
+PUBLIC void vga_set_mode(int mode)
+{
+	if (mode < 0 || mode >= NR_CON_MODES) {
+		return;
+	}
+
+	disable_int();
+	if (mode != CON_MODE_80x25 && !font8_ready) {
+		make_font8();
+		font8_ready = 1;
+	}
+	write_regs(&vga_modes[mode]);
+	enable_int();
+}
+
+/*======================================================================*
+                           write_regs
+ *======================================================================*/
+PRIVATE void write_regs(const VGA_REGS* p_regs)
+{
+	int i;
+	u8 val;
+
+	/* 换时钟和改 sequencer 时让它先停在同步复位，改完再放开 */
+	out_byte(VGA_SEQ_INDEX, 0);
+	out_byte(VGA_SEQ_DATA, 0x01);
+
+	out_byte(VGA_MISC_WRITE, p_regs->misc);
+
+	for (i = 1; i < 5; i++) {
+		out_byte(VGA_SEQ_INDEX, i);
+		out_byte(VGA_SEQ_DATA, p_regs->seq[i]);
+	}
+
+	out_byte(VGA_SEQ_INDEX, 0);
+	out_byte(VGA_SEQ_DATA, 0x03);
+
+	/* CRTC 0~7 有写保护，先打开 */
+	for (i = 0; i < 25; i++) {
+		val = p_regs->crtc[i];
+		if (i == 0x03) {
+			val |= 0x80;
+		}
+		else if (i == 0x11) {
+			val &= ~0x80;
+		}
+		out_byte(CRTC_ADDR_REG, i);
+		out_byte(CRTC_DATA_REG, val);
+	}
+
+	for (i = 0; i < 9; i++) {
+		out_byte(VGA_GC_INDEX, i);
+		out_byte(VGA_GC_DATA, p_regs->gc[i]);
+	}
+
+	/* AC 的索引和数据用同一个端口，读 INSTAT 让它回到索引状态 */
+	for (i = 0; i < 21; i++) {
+		in_byte(VGA_INSTAT_READ);
+		out_byte(VGA_AC_INDEX, i);
+		out_byte(VGA_AC_INDEX, p_regs->ac[i]);
+	}
+	/* 重新打开显示 */
+	in_byte(VGA_INSTAT_READ);
+	out_byte(VGA_AC_INDEX, 0x20);
+}
+
+/*======================================================================*
+                           make_font8
+ *----------------------------------------------------------------------*
+ 把 plane 2 映射到 VGA_FONT_BASE，由字体区 0 中 8x16 的字体每两行
+ 取或得到 8x8 的字体，写到字体区 1，最后恢复文本模式的映射。
+ *======================================================================*/
+PRIVATE void make_font8()
+{
+	u8* p_font = (u8*)VGA_FONT_BASE;
+	int ch;
+	int line;
+
+	out_byte(VGA_SEQ_INDEX, 2);	/* 只写 plane 2 */
+	out_byte(VGA_SEQ_DATA, 0x04);
+	out_byte(VGA_SEQ_INDEX, 4);	/* 关掉奇偶寻址 */
+	out_byte(VGA_SEQ_DATA, 0x06);
+	out_byte(VGA_GC_INDEX, 4);	/* 读 plane 2 */
+	out_byte(VGA_GC_DATA, 0x02);
+	out_byte(VGA_GC_INDEX, 5);
+	out_byte(VGA_GC_DATA, 0x00);
+	out_byte(VGA_GC_INDEX, 6);	/* A0000 开始的 64K */
+	out_byte(VGA_GC_DATA, 0x04);
+
+	for (ch = 0; ch < 256; ch++) {
+		for (line = 0; line < 8; line++) {
+			p_font[FONT8_BANK + ch * FONT_SLOT + line] =
+				p_font[ch * FONT_SLOT + line * 2] |
+				p_font[ch * FONT_SLOT + line * 2 + 1];
+		}
+	}
+
+	out_byte(VGA_SEQ_INDEX, 2);
+	out_byte(VGA_SEQ_DATA, 0x03);
+	out_byte(VGA_SEQ_INDEX, 4);
+	out_byte(VGA_SEQ_DATA, 0x02);
+	out_byte(VGA_GC_INDEX, 4);
+	out_byte(VGA_GC_DATA, 0x00);
+	out_byte(VGA_GC_INDEX, 5);
+	out_byte(VGA_GC_DATA, 0x10);
+	out_byte(VGA_GC_INDEX, 6);
+	out_byte(VGA_GC_DATA, 0x0E);
+}
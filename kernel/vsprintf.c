@@ -13,6 +13,32 @@
  *  为更好地理解此函数的原理，可参考 printf 的注释部分。
  */
 
+/*======================================================================*
+                                i2d
+ *======================================================================*/
+PRIVATE char * i2d(char * str, int num)/* 十进制, 负数前面加 '-' */
+{
+	char	tmp[12];
+	char *	q = tmp;
+	char *	p = str;
+	u32	n = num;
+
+	if (num < 0) {
+		*p++ = '-';
+		n = -num;
+	}
+	do {
+		*q++ = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	while (q != tmp) {
+		*p++ = *--q;
+	}
+	*p = 0;
+
+	return str;
+}
+
 /*======================================================================*
                                 vsprintf
  *======================================================================*/
@@ -37,7 +63,16 @@ int vsprintf(char *buf, const char *fmt, va_list args)
 			p_next_arg += 4;
 			p += strlen(tmp);
 			break;
+		case 'd':
+			i2d(tmp, *((int*)p_next_arg));
+			strcpy(p, tmp);
+			p_next_arg += 4;
+			p += strlen(tmp);
+			break;
 		case 's':
+			strcpy(p, *((char**)p_next_arg));
+			p_next_arg += 4;
+			p += strlen(p);
 			break;
 		default:
 			break;
@@ -47,3 +82,16 @@ int vsprintf(char *buf, const char *fmt, va_list args)
 	return (p - buf);
 }
 
+/*======================================================================*
+                                sprintf
+ *======================================================================*/
+int sprintf(char *buf, const char *fmt, ...)
+{
+	int i;
+	va_list arg = (va_list)((char*)(&fmt) + 4); /*4是参数fmt所占堆栈中的大小*/
+
+	i = vsprintf(buf, fmt, arg);
+	buf[i] = 0;
+
+	return i;
+}
@@ -22,6 +22,8 @@ global	enable_irq
 global	disable_irq
 global	enable_int
 global	disable_int
+global	disable_int_save
+global	restore_int
 
 
 
@@ -212,4 +214,23 @@ enable_int:
 	sti
 	ret
 
+; ========================================================================
+;		   u32 disable_int_save();
+; ========================================================================
+; 关中断，返回关之前的 eflags，交给 restore_int 恢复。
+; 初始化时中断本来就是关着的，这样不会被提前打开。
+disable_int_save:
+	pushf
+	pop	eax
+	cli
+	ret
+
+; ========================================================================
+;		   void restore_int(u32 flags);
+; ========================================================================
+restore_int:
+	push	dword [esp + 4]
+	popf
+	ret
+
 
@@ -10,6 +10,8 @@
 ; 导出函数
 global	memcpy
 global	memset
+global	memset16
+global	memmove16
 global  strcpy
 global  strlen
 
@@ -88,6 +90,71 @@ memset:
 ; ------------------------------------------------------------------------
 
 
+; ------------------------------------------------------------------------
+; void memset16(void* p_dst, u16 val, int count);
+; 填 count 个 16 位字，用来一次写一片 字符+属性 的显存
+; ------------------------------------------------------------------------
+memset16:
+	push	ebp
+	mov	ebp, esp
+
+	push	edi
+	push	ecx
+
+	mov	edi, [ebp + 8]	; Destination
+	mov	eax, [ebp + 12]	; Word to be putted
+	mov	ecx, [ebp + 16]	; Counter
+	cld
+	rep	stosw
+
+	pop	ecx
+	pop	edi
+	mov	esp, ebp
+	pop	ebp
+
+	ret			; 函数结束，返回
+; memset16 结束-----------------------------------------------------------
+
+
+; ------------------------------------------------------------------------
+; void memmove16(void* p_dst, void* p_src, int count);
+; 移动 count 个 16 位字，源和目的可以重叠
+; ------------------------------------------------------------------------
+memmove16:
+	push	ebp
+	mov	ebp, esp
+
+	push	esi
+	push	edi
+	push	ecx
+
+	mov	edi, [ebp + 8]	; Destination
+	mov	esi, [ebp + 12]	; Source
+	mov	ecx, [ebp + 16]	; Counter
+	cmp	edi, esi
+	jbe	.1		; 目的在源之前，从前往后移
+
+	lea	esi, [esi + ecx * 2 - 2]	; 目的在源之后，从后往前移
+	lea	edi, [edi + ecx * 2 - 2]
+	std
+	rep	movsw
+	cld
+	jmp	.2
+.1:
+	cld
+	rep	movsw
+.2:
+
+	pop	ecx
+	pop	edi
+	pop	esi
+	mov	esp, ebp
+	pop	ebp
+
+	ret			; 函数结束，返回
+; memmove16 结束----------------------------------------------------------
+
+
 ; ------------------------------------------------------------------------
 ; char* strcpy(char* p_dst, char* p_src);
 ; ------------------------------------------------------------------------